@@ -20,83 +20,445 @@
 **/
 /* }}} */
 
-#include "Driver.hpp"
-#include "Syntax.hpp"
+#include "Code.hpp"
+#include "Exception.hpp"
+#include "Highlight.hpp"
 
+#include <memory>
 #include <sstream>
 
 #include <node_api.h>
 
 namespace cylang {
 
+// the input of one compile: either borrowed from a Buffer/Uint8Array or held in data_ for strings
+struct Source {
+    const char *start_;
+    size_t size_;
+    std::string data_;
+
+    Source() :
+        start_(NULL),
+        size_(0)
+    {
+    }
+
+    bool Borrowed() const {
+        return start_ != data_.data();
+    }
+
+    // copies borrowed data into data_, so that nothing in the JS heap can change it from under a compile
+    void Own() {
+        if (Borrowed()) {
+            data_.assign(start_, size_);
+            start_ = data_.data();
+        }
+    }
+};
+
+// appends to a std::string, so the output can be handed over without the copy std::stringbuf::str() makes
+class Sink :
+    public std::streambuf
+{
+  private:
+    std::string &data_;
+
+  protected:
+    virtual int_type overflow(int_type value) {
+        if (!traits_type::eq_int_type(value, traits_type::eof()))
+            data_.push_back(traits_type::to_char_type(value));
+        return traits_type::not_eof(value);
+    }
+
+    virtual std::streamsize xsputn(const char *data, std::streamsize size) {
+        data_.append(data, size);
+        return size;
+    }
+
+  public:
+    Sink(std::string &data) :
+        data_(data)
+    {
+    }
+};
+
 class Binding {
   public:
     static napi_value Compile(napi_env env, napi_callback_info info) {
-        napi_value argv[3];
-        size_t argc = 3;
+        napi_value argv[5];
+        size_t argc = 5;
         napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
-        if (argc != 3) {
+        if (argc != 5) {
             napi_throw_error(env, "EINVAL", "Missing one or more arguments");
             return NULL;
         }
 
-        CYPool pool;
+        Source source;
+        if (!GetSourceArg(env, argv[0], source))
+            return NULL;
+
+        bool strict, pretty, minify, buffer;
+        if (!GetBoolArg(env, argv[1], strict) || !GetBoolArg(env, argv[2], pretty) || !GetBoolArg(env, argv[3], minify) || !GetBoolArg(env, argv[4], buffer))
+            return NULL;
+
+        std::string result;
+        std::string error;
+        if (!Compile_(source, strict, pretty, minify, result, error)) {
+            napi_throw_error(env, "EINVAL", error.c_str());
+            return NULL;
+        }
+
+        return CreateResult(env, result, buffer);
+    }
+
+    static napi_value CompileAll(napi_env env, napi_callback_info info) {
+        napi_value argv[5];
+        size_t argc = 5;
+        napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+        if (argc != 5) {
+            napi_throw_error(env, "EINVAL", "Missing one or more arguments");
+            return NULL;
+        }
 
-        std::string code;
-        if (!GetStringArg(env, argv[0], code))
+        bool array;
+        if (napi_is_array(env, argv[0], &array) != napi_ok || !array) {
+            napi_throw_type_error(env, "EINVAL", "Expected an array");
             return NULL;
+        }
 
-        bool strict;
-        if (!GetBoolArg(env, argv[1], strict))
+        bool strict, pretty, minify, buffer;
+        if (!GetBoolArg(env, argv[1], strict) || !GetBoolArg(env, argv[2], pretty) || !GetBoolArg(env, argv[3], minify) || !GetBoolArg(env, argv[4], buffer))
             return NULL;
 
-        bool pretty;
-        if (!GetBoolArg(env, argv[2], pretty))
+        uint32_t count;
+        napi_get_array_length(env, argv[0], &count);
+
+        napi_value results;
+        if (napi_create_array_with_length(env, count, &results) != napi_ok)
             return NULL;
 
-        std::stringbuf stream(code);
-        CYDriver driver(pool, stream);
-        driver.strict_ = strict;
+        // one source, result and error string serve every element, so their storage is only grown once
+        Source source;
+        std::string result;
+        std::string error;
 
-        if (driver.Parse() || !driver.errors_.empty()) {
-            for (CYDriver::Errors::const_iterator error(driver.errors_.begin()); error != driver.errors_.end(); ++error) {
-                auto message(error->message_);
-                napi_throw_error(env, "EINVAL", message.c_str());
+        for (uint32_t index(0); index != count; ++index) {
+            napi_value element;
+            if (napi_get_element(env, argv[0], index, &element) != napi_ok)
+                return NULL;
+            if (!GetSourceArg(env, element, source))
+                return NULL;
+
+            result.clear();
+            if (!Compile_(source, strict, pretty, minify, result, error)) {
+                ThrowError(env, error, index);
                 return NULL;
             }
 
-            napi_throw_error(env, "EINVAL", "Invalid code");
+            napi_value value(CreateResult(env, result, buffer));
+            if (value == NULL || napi_set_element(env, results, index, value) != napi_ok)
+                return NULL;
+        }
+
+        return results;
+    }
+
+    static napi_value CompileAsync(napi_env env, napi_callback_info info) {
+        napi_value argv[5];
+        size_t argc = 5;
+        napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+        if (argc != 5) {
+            napi_throw_error(env, "EINVAL", "Missing one or more arguments");
+            return NULL;
+        }
+
+        std::unique_ptr<CompileWork> work(new CompileWork());
+
+        if (!GetSourceArg(env, argv[0], work->source_))
+            return NULL;
+
+        if (!GetBoolArg(env, argv[1], work->strict_) || !GetBoolArg(env, argv[2], work->pretty_) || !GetBoolArg(env, argv[3], work->minify_) || !GetBoolArg(env, argv[4], work->buffer_))
+            return NULL;
+
+        // JS keeps running while the threadpool compiles, and could write to or detach a borrowed Buffer meanwhile
+        work->source_.Own();
+
+        napi_value promise;
+        if (napi_create_promise(env, &work->deferred_, &promise) != napi_ok)
+            return NULL;
+
+        napi_value name;
+        napi_create_string_utf8(env, "cylang.compile", NAPI_AUTO_LENGTH, &name);
+        if (napi_create_async_work(env, NULL, name, &ExecuteCompile, &CompleteCompile, work.get(), &work->work_) != napi_ok)
+            return NULL;
+        if (napi_queue_async_work(env, work->work_) != napi_ok) {
+            napi_delete_async_work(env, work->work_);
+            return NULL;
+        }
+
+        work.release();
+        return promise;
+    }
+
+    static napi_value Tokenize(napi_env env, napi_callback_info info) {
+        napi_value argv[3];
+        size_t argc = 3;
+        napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+        if (argc != 3) {
+            napi_throw_error(env, "EINVAL", "Missing one or more arguments");
             return NULL;
         }
 
-        if (driver.script_ == NULL) {
-            napi_throw_error(env, "EINVAL", "Invalid code");
+        Source source;
+        if (!GetSourceArg(env, argv[0], source))
+            return NULL;
+
+        double from, to;
+        if (!GetOffsetArg(env, argv[1], from) || !GetOffsetArg(env, argv[2], to))
+            return NULL;
+
+        // offsets into a JS string are in UTF-16 code units, while the scanner works on UTF-8
+        bool units(!source.Borrowed());
+
+        size_t begin(units ? Bytes(source, from) : from < source.size_ ? size_t(from) : source.size_);
+        size_t end(units ? Bytes(source, to) : to < source.size_ ? size_t(to) : source.size_);
+
+        CYPool pool;
+        CYLexerToken *tokens;
+        size_t count;
+
+        try {
+            count = CYLexerTokenize(pool, source.start_, source.size_, begin, end, tokens);
+        } catch (const CYException &exception) {
+            napi_throw_error(env, "EINVAL", exception.PoolCString(pool));
             return NULL;
         }
 
-        std::stringbuf str;
-        CYOptions options;
-        CYOutput out(str, options);
-        out.pretty_ = pretty;
-        driver.Replace(options);
-        out << *driver.script_;
+        napi_value kinds, starts, ends;
+        uint8_t *kind;
+        uint32_t *start, *stop;
+        if (!CreateArray(env, napi_uint8_array, count, sizeof(uint8_t), kinds, kind) ||
+            !CreateArray(env, napi_uint32_array, count, sizeof(uint32_t), starts, start) ||
+            !CreateArray(env, napi_uint32_array, count, sizeof(uint32_t), ends, stop))
+            return NULL;
+
+        // token offsets only ever increase, so converting them back to code units is one walk over the data
+        size_t offset(0), unit(0);
+        for (size_t index(0); index != count; ++index) {
+            const CYLexerToken &token(tokens[index]);
+            kind[index] = token.highlight_;
+            start[index] = units ? Units(source, offset, unit, token.begin_) : token.begin_;
+            stop[index] = units ? Units(source, offset, unit, token.end_) : token.end_;
+        }
 
-        std::string result(str.str());
-        napi_value result_value;
-        napi_create_string_utf8(env, result.c_str(), NAPI_AUTO_LENGTH, &result_value);
-        return result_value;
+        napi_value result;
+        napi_create_object(env, &result);
+        napi_set_named_property(env, result, "kinds", kinds);
+        napi_set_named_property(env, result, "starts", starts);
+        napi_set_named_property(env, result, "ends", ends);
+        return result;
     }
 
   private:
-    static bool GetStringArg(napi_env env, napi_value value, std::string &result) {
+    // everything a compile on the threadpool needs; it only touches the JS heap before and after
+    struct CompileWork {
+        napi_async_work work_;
+        napi_deferred deferred_;
+
+        Source source_;
+        bool strict_;
+        bool pretty_;
+        bool minify_;
+        bool buffer_;
+
+        bool succeeded_;
+        std::string result_;
+        std::string error_;
+    };
+
+    // CYCompile is reentrant, so this may run on any thread
+    static bool Compile_(const Source &source, bool strict, bool pretty, bool minify, std::string &result, std::string &error) {
+        CYCompileOptions options;
+        options.strict_ = strict;
+        options.pretty_ = pretty;
+        options.options_.minify_ = minify;
+
+        try {
+            CYStream stream(source.start_, source.start_ + source.size_);
+            Sink sink(result);
+            CYCompile(options, stream, sink);
+            return true;
+        } catch (const CYException &exception) {
+            CYPool pool;
+            error = exception.PoolCString(pool);
+            return false;
+        }
+    }
+
+    static void ExecuteCompile(napi_env env, void *data) {
+        CompileWork &work(*static_cast<CompileWork *>(data));
+        work.succeeded_ = Compile_(work.source_, work.strict_, work.pretty_, work.minify_, work.result_, work.error_);
+    }
+
+    static void CompleteCompile(napi_env env, napi_status status, void *data) {
+        std::unique_ptr<CompileWork> work(static_cast<CompileWork *>(data));
+
+        napi_value value;
+        if (status != napi_ok) {
+            napi_value code, message;
+            napi_create_string_utf8(env, "ECANCELED", NAPI_AUTO_LENGTH, &code);
+            napi_create_string_utf8(env, "Compilation was cancelled", NAPI_AUTO_LENGTH, &message);
+            napi_create_error(env, code, message, &value);
+            napi_reject_deferred(env, work->deferred_, value);
+        } else if (work->succeeded_) {
+            if ((value = CreateResult(env, work->result_, work->buffer_)) != NULL)
+                napi_resolve_deferred(env, work->deferred_, value);
+            else if (napi_get_and_clear_last_exception(env, &value) == napi_ok)
+                napi_reject_deferred(env, work->deferred_, value);
+        } else {
+            napi_value code, message;
+            napi_create_string_utf8(env, "EINVAL", NAPI_AUTO_LENGTH, &code);
+            napi_create_string_utf8(env, work->error_.c_str(), work->error_.size(), &message);
+            napi_create_error(env, code, message, &value);
+            napi_reject_deferred(env, work->deferred_, value);
+        }
+
+        napi_delete_async_work(env, work->work_);
+    }
+
+    static void FinalizeResult(napi_env env, void *data, void *hint) {
+        delete static_cast<std::string *>(hint);
+    }
+
+    // returns NULL with an exception pending, throwing one unless N-API already did
+    static napi_value ThrowResult(napi_env env) {
+        bool pending;
+        if (napi_is_exception_pending(env, &pending) != napi_ok || !pending)
+            napi_throw_error(env, "ENOMEM", "Unable to create the result");
+        return NULL;
+    }
+
+    // a Buffer result takes over the string's storage instead of copying it, unless the runtime disallows external buffers
+    static napi_value CreateResult(napi_env env, std::string &result, bool buffer) {
+        napi_value value;
+
+        if (!buffer) {
+            if (napi_create_string_utf8(env, result.data(), result.size(), &value) != napi_ok)
+                return ThrowResult(env);
+        } else if (result.empty()) {
+            void *data;
+            if (napi_create_buffer(env, 0, &data, &value) != napi_ok)
+                return ThrowResult(env);
+        } else {
+            std::string *data(new std::string());
+            data->swap(result);
+            if (napi_create_external_buffer(env, data->size(), &(*data)[0], &FinalizeResult, data, &value) != napi_ok) {
+                data->swap(result);
+                delete data;
+                void *copy;
+                if (napi_create_buffer_copy(env, result.size(), result.data(), &copy, &value) != napi_ok)
+                    return ThrowResult(env);
+            }
+        }
+
+        return value;
+    }
+
+    template <typename Type_>
+    static bool CreateArray(napi_env env, napi_typedarray_type type, size_t count, size_t size, napi_value &value, Type_ *&data) {
+        void *base;
+        napi_value buffer;
+        if (napi_create_arraybuffer(env, count * size, &base, &buffer) != napi_ok)
+            return false;
+        if (napi_create_typedarray(env, type, count, buffer, 0, &value) != napi_ok)
+            return false;
+        data = static_cast<Type_ *>(base);
+        return true;
+    }
+
+    // the UTF-16 width of the character a UTF-8 byte starts, counting continuation bytes as nothing
+    static size_t Width(char value) {
+        uint8_t byte(value);
+        if ((byte & 0xc0) == 0x80)
+            return 0;
+        return byte >= 0xf0 ? 2 : 1;
+    }
+
+    static size_t Bytes(const Source &source, double units) {
+        size_t offset(0);
+        for (double unit(0); offset != source.size_ && unit < units; ++offset)
+            unit += Width(source.start_[offset]);
+        while (offset != source.size_ && Width(source.start_[offset]) == 0)
+            ++offset;
+        return offset;
+    }
+
+    static size_t Units(const Source &source, size_t &offset, size_t &unit, size_t target) {
+        for (; offset != target; ++offset)
+            unit += Width(source.start_[offset]);
+        return unit;
+    }
+
+    static void ThrowError(napi_env env, const std::string &message, uint32_t index) {
+        napi_value code, text, error, position;
+        napi_create_string_utf8(env, "EINVAL", NAPI_AUTO_LENGTH, &code);
+        napi_create_string_utf8(env, message.data(), message.size(), &text);
+        napi_create_error(env, code, text, &error);
+        napi_create_uint32(env, index, &position);
+        napi_set_named_property(env, error, "index", position);
+        napi_throw(env, error);
+    }
+
+    // strings are copied out of the JS heap; Buffers and Uint8Arrays are read in place
+    static bool GetSourceArg(napi_env env, napi_value value, Source &result) {
+        bool buffer;
+        if (napi_is_buffer(env, value, &buffer) == napi_ok && buffer) {
+            void *data;
+            size_t size;
+            if (napi_get_buffer_info(env, value, &data, &size) != napi_ok)
+                return false;
+            result.data_.clear();
+            result.start_ = static_cast<const char *>(data);
+            result.size_ = size;
+            return true;
+        }
+
+        bool array;
+        if (napi_is_typedarray(env, value, &array) == napi_ok && array) {
+            napi_typedarray_type type;
+            size_t size;
+            void *data;
+            if (napi_get_typedarray_info(env, value, &type, &size, &data, NULL, NULL) != napi_ok)
+                return false;
+            if (type != napi_uint8_array && type != napi_int8_array && type != napi_uint8_clamped_array) {
+                napi_throw_type_error(env, "EINVAL", "Expected a string, Buffer or Uint8Array");
+                return false;
+            }
+            result.data_.clear();
+            result.start_ = static_cast<const char *>(data);
+            result.size_ = size;
+            return true;
+        }
+
         size_t size;
         if (napi_get_value_string_utf8(env, value, NULL, 0, &size) != napi_ok) {
-            napi_throw_type_error(env, "EINVAL", "Expected a string");
+            napi_throw_type_error(env, "EINVAL", "Expected a string, Buffer or Uint8Array");
             return false;
         }
-        result.resize(size, '\0');
+        result.data_.resize(size, '\0');
+
+        napi_get_value_string_utf8(env, value, &result.data_[0], size + 1, &size);
+
+        result.start_ = result.data_.data();
+        result.size_ = size;
+        return true;
+    }
 
-        napi_get_value_string_utf8(env, value, &result[0], size + 1, &size);
+    static bool GetOffsetArg(napi_env env, napi_value value, double &result) {
+        if (napi_get_value_double(env, value, &result) != napi_ok || !(result >= 0)) {
+            napi_throw_type_error(env, "EINVAL", "Expected a non-negative offset");
+            return false;
+        }
 
         return true;
     }
@@ -111,9 +473,14 @@ class Binding {
     }
 };
 
+// NAPI_MODULE_INIT is context-aware: this runs once per environment, including each worker_thread,
+// and the binding keeps no state of its own
 NAPI_MODULE_INIT() {
     napi_property_descriptor desc[] = {
         {"compile", NULL, Binding::Compile, NULL, NULL, NULL, napi_default, NULL},
+        {"compileAll", NULL, Binding::CompileAll, NULL, NULL, NULL, napi_default, NULL},
+        {"compileAsync", NULL, Binding::CompileAsync, NULL, NULL, NULL, napi_default, NULL},
+        {"tokenize", NULL, Binding::Tokenize, NULL, NULL, NULL, napi_default, NULL},
     };
 
     if (napi_define_properties(env, exports, sizeof(desc) / sizeof(desc[0]), desc) != napi_ok)
@@ -0,0 +1,28 @@
+const cylang = require('..');
+
+function measure(name, bytes, fn) {
+  fn();
+
+  const start = process.hrtime.bigint();
+  fn();
+  const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+
+  console.log(`${name.padEnd(32)} ${(seconds * 1000).toFixed(1).padStart(9)} ms ${(bytes / seconds / 1048576).toFixed(1).padStart(8)} MiB/s`);
+}
+
+const snippets = [];
+for (let i = 0; i !== 10000; ++i)
+  snippets.push(`(function (x) { return x.y[${i}] + @selector(foo:bar:); })`);
+const snippetBytes = snippets.reduce((total, snippet) => total + snippet.length, 0);
+const snippetBuffers = snippets.map(snippet => Buffer.from(snippet));
+
+measure('10k snippets, compile', snippetBytes, () => snippets.forEach(snippet => cylang.compile(snippet)));
+measure('10k snippets, compile(Buffer)', snippetBytes, () => snippetBuffers.forEach(snippet => cylang.compile(snippet, { buffer: true })));
+measure('10k snippets, compileAll', snippetBytes, () => cylang.compileAll(snippets));
+measure('10k snippets, compileAll(Buffer)', snippetBytes, () => cylang.compileAll(snippetBuffers, { buffer: true }));
+
+const large = snippets.join(';\n').repeat(8);
+const largeBuffer = Buffer.from(large);
+
+measure(`${(large.length / 1048576).toFixed(1)} MiB source, compile`, large.length, () => cylang.compile(large));
+measure(`${(large.length / 1048576).toFixed(1)} MiB source, compile(Buffer)`, large.length, () => cylang.compile(largeBuffer, { buffer: true }));
@@ -0,0 +1,36 @@
+const os = require('os');
+
+// the threadpool is sized on first use, so this has to happen before any async work is queued
+const threads = Math.min(os.cpus().length, 16);
+process.env.UV_THREADPOOL_SIZE = String(threads);
+
+const cylang = require('..');
+
+const sources = [];
+for (let i = 0; i !== 64; ++i)
+  sources.push(`(function (x) { return x.y[${i}] + @selector(foo:bar:); })\n`.repeat(256));
+
+async function run(concurrency, count) {
+  let next = 0;
+  async function worker() {
+    while (next !== count)
+      await cylang.compileAsync(sources[next++ % sources.length]);
+  }
+
+  const start = process.hrtime.bigint();
+  await Promise.all(Array.from({ length: concurrency }, worker));
+  return Number(process.hrtime.bigint() - start) / 1e9;
+}
+
+(async function () {
+  const count = 512;
+  await run(threads, count);
+
+  let base;
+  for (let concurrency = 1; concurrency <= threads; concurrency *= 2) {
+    const seconds = await run(concurrency, count);
+    if (base === undefined)
+      base = seconds;
+    console.log(`${String(concurrency).padStart(2)} threads ${(count / seconds).toFixed(1).padStart(9)} compiles/s ${(base / seconds).toFixed(2).padStart(6)}x`);
+  }
+})();
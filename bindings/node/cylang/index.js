@@ -1,7 +1,25 @@
 const binding = require('bindings')('cylang_binding');
 
+const tokenKinds = [
+  'comment',
+  'constant',
+  'control',
+  'error',
+  'identifier',
+  'meta',
+  'nothing',
+  'operator',
+  'special',
+  'structure',
+  'type'
+];
+
 module.exports = {
-  compile: compile
+  compile: compile,
+  compileAll: compileAll,
+  compileAsync: compileAsync,
+  tokenize: tokenize,
+  tokenKinds: tokenKinds
 };
 
 function compile(source, options) {
@@ -9,6 +27,39 @@ function compile(source, options) {
 
   const strict = ('strict' in options) ? options.strict : false;
   const pretty = ('pretty' in options) ? options.pretty : false;
+  const minify = ('minify' in options) ? options.minify : false;
+  const buffer = ('buffer' in options) ? options.buffer : false;
+
+  return binding.compile(source, strict, pretty, minify, buffer);
+}
+
+function compileAll(sources, options) {
+  options = options || {};
+
+  const strict = ('strict' in options) ? options.strict : false;
+  const pretty = ('pretty' in options) ? options.pretty : false;
+  const minify = ('minify' in options) ? options.minify : false;
+  const buffer = ('buffer' in options) ? options.buffer : false;
+
+  return binding.compileAll(sources, strict, pretty, minify, buffer);
+}
+
+function compileAsync(source, options) {
+  options = options || {};
+
+  const strict = ('strict' in options) ? options.strict : false;
+  const pretty = ('pretty' in options) ? options.pretty : false;
+  const minify = ('minify' in options) ? options.minify : false;
+  const buffer = ('buffer' in options) ? options.buffer : false;
+
+  return binding.compileAsync(source, strict, pretty, minify, buffer);
+}
+
+function tokenize(source, options) {
+  options = options || {};
+
+  const from = ('from' in options) ? options.from : 0;
+  const to = ('to' in options) ? options.to : Infinity;
 
-  return binding.compile(source, strict, pretty);
+  return binding.tokenize(source, from, to);
 }
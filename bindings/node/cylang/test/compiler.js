@@ -26,4 +26,203 @@ describe('Compiler', function () {
     const prettyOutput = cylang.compile(code, { pretty: true });
     prettyOutput.should.not.equal(compactOutput);
   });
+
+  it('should compile escape-free literals like escaped ones', function () {
+    cylang.compile(`x='ab'+"cd"`).should.equal(cylang.compile(`x='\\x61b'+"c\\x64"`));
+    cylang.compile('x=`a${y}b${z}c`').should.equal(cylang.compile('x=`\\x61${y}\\x62${z}\\x63`'));
+  });
+
+  it('should index natively unless the object brings $cyg/$cys', function () {
+    cylang.compile('[10,20].[1]').should.not.match(/\$cyg/);
+    cylang.compile('[x].[0]=[y,{}.[k]].[1]').should.not.match(/\.\[/);
+    cylang.compile('[x].[0]=@selector(a)').should.not.match(/@selector/);
+    eval(cylang.compile('[0].[0]=[7,8].[1]')).should.equal(8);
+    eval(cylang.compile('var a=[10,20];a.[1]')).should.equal(20);
+    eval(cylang.compile('var a=[10,20];a.[1]+=2;a[1]')).should.equal(22);
+    eval(cylang.compile('var d={$cyg:function(k){return k*2}};d.[21]')).should.equal(42);
+    eval(cylang.compile('var s={$cys:function(k,v){this.k=k;this.v=v}};s.["x"]=7;s.k+s.v')).should.equal('x7');
+    eval(cylang.compile('var s={$cyg:function(k){return 1},$cys:function(k,v){this.k=k;this.v=v}};s.["x"]+=7;s.k+s.v')).should.equal('x8');
+    eval(cylang.compile('var s={$cyg:function(k){return 6},$cys:function(k,v){this.v=v}};s.["x"]<<=2;s.v')).should.equal(24);
+  });
+
+  it('should register each selector once per script', function () {
+    const output = cylang.compile('x=@selector(foo:bar:);function f(){return @selector(foo:bar:)}');
+    output.should.match(/^var \$cySfoo\$_bar\$_;/);
+    output.should.not.match(/\$cySfoo\$_bar\$_,/);
+    output.should.match(/\$cySfoo\$_bar\$_\|\|\(\$cySfoo\$_bar\$_=sel_registerName\("foo:bar:"\)\)/);
+
+    const distinct = cylang.compile('x=@selector(a:b:);y=@selector(a$b:)');
+    distinct.should.match(/\$cySa\$_b\$_=sel_registerName\("a:b:"\)/);
+    distinct.should.match(/\$cySa\$\$b\$_=sel_registerName\("a\$b:"\)/);
+  });
+
+  it('should fold static types into encodings', function () {
+    cylang.compile('typedef unsigned int *const p').should.match(/new Type\("r\^I"\)/);
+    cylang.compile('typedef char *s').should.match(/char\.pointerTo\(\)/);
+    cylang.compile('@implementation A : NSObject\n- (int) foo:(double)x { return 1; }\n@end').should.match(/"i@:d"/);
+  });
+
+  it('should lower optional member access without closures', function () {
+    cylang.compile('a?.b;a?.m(1)').should.not.match(/function/);
+    eval(cylang.compile('var o={b:{c:1}};o?.b?.c')).should.equal(1);
+    should(eval(cylang.compile('var n=null;n?.b'))).equal(null);
+    eval(cylang.compile('var o={m:function(){return this.v},v:3};o?.m()')).should.equal(3);
+  });
+
+  it('should return from blocks passed to iteration helpers without throwing', function () {
+    const output = cylang.compile('(function(xs){xs.forEach {|x| if (x > 1) return x; }; return 0})');
+    output.should.not.match(/throw/);
+    const f = eval(output);
+    f([1, 2, 3]).should.equal(2);
+    f([1]).should.equal(0);
+    cylang.compile('(function(o){o.each {|x| return x; }})').should.match(/throw/);
+
+    const some = eval(cylang.compile('(function(xs){xs.some {|x| if (x > 1) return x * 10; }; return 0})'));
+    const xs = [1, 2, 3, 4];
+    let calls = 0;
+    xs.some = function (f) {
+      return Array.prototype.some.call(this, x => (++calls, f(x)));
+    };
+    some(xs).should.equal(20);
+    calls.should.equal(2);
+  });
+
+  it('should fold literals and the constants bound to them', function () {
+    cylang.compile('x=base+0x10*4').should.equal('x=base+64');
+    cylang.compile('x=typeof 1==="number"&&!0').should.equal('x=!0');
+    cylang.compile('(function(){const K=3;return p+(K<<2)})').should.match(/return p\+12/);
+    eval(cylang.compile('1-5')).should.equal(-4);
+    eval(cylang.compile('-7>>1')).should.equal(-4);
+    eval(cylang.compile('0x80000000|0')).should.equal(-2147483648);
+    eval(cylang.compile('-1>>>28')).should.equal(15);
+    eval(cylang.compile('const x=1; if (0) x=2; x')).should.equal(1);
+    eval(cylang.compile('"x"+1/10')).should.equal('x0.1');
+    eval(cylang.compile('const r=0.1; "r="+r')).should.equal('r=0.1');
+    eval(cylang.compile('"n="+1e21')).should.equal('n=1e+21');
+    cylang.compile('x="a"+0.5*2').should.equal('x="a1"');
+    cylang.compile('const y=1; if (0) { y++; y+=1; for (y in o); }').should.not.match(/1\+\+|1\+=|\(1 in/);
+  });
+
+  it('should drop dead code and unused locals when minifying', function () {
+    const source = '(function(){if(false){a()}else{b()}return 1;c()})';
+    const output = cylang.compile(source, { minify: true });
+    output.should.not.match(/a\(\)|c\(\)|if/);
+    output.should.match(/b\(\)/);
+    cylang.compile(source).should.match(/if/);
+
+    const unused = cylang.compile('(function(){function unused(){}var v=1;var w=2;return w})', { minify: true });
+    unused.should.not.match(/unused|1/);
+    eval(unused)().should.equal(2);
+
+    const first = cylang.compile('(function(){var v=1;var w=2;return v})', { minify: true });
+    first.should.not.match(/2/);
+    eval(first)().should.equal(1);
+    eval(cylang.compile('(function(){function a(){return 3}function b(){}return a()})', { minify: true }))().should.equal(3);
+  });
+
+  it('should compile scripts with a million statements', function () {
+    this.timeout(60000);
+
+    const count = 1000000;
+    const output = cylang.compile('x++;'.repeat(count));
+    (output.split('x++').length - 1).should.equal(count);
+  });
+
+  it('should compile asynchronously', function () {
+    const code = 'extern "C" int puts(char const*)';
+    return cylang.compileAsync(code).then(function (output) {
+      output.should.equal(cylang.compile(code));
+    });
+  });
+
+  it('should reject on syntax error when compiling asynchronously', function () {
+    return cylang.compileAsync('function) {}').then(function () {
+      throw new Error('should have been rejected');
+    }, function (error) {
+      error.message.should.match(/^syntax error, unexpected \)/);
+      error.code.should.equal('EINVAL');
+    });
+  });
+
+  it('should compile concurrently on the threadpool', function () {
+    const sources = [];
+    for (let i = 0; i !== 64; ++i)
+      sources.push(`(function (x) { return x + ${i}; })`);
+    return Promise.all(sources.map(source => cylang.compileAsync(source, { pretty: true }))).then(function (outputs) {
+      outputs.should.eql(sources.map(source => cylang.compile(source, { pretty: true })));
+    });
+  });
+
+  it('should not see writes to a Buffer made while compiling asynchronously', function () {
+    const code = 'extern "C" int puts(char const*)';
+    const source = Buffer.from(code);
+    const promise = cylang.compileAsync(source);
+    source.fill(0x20);
+    return promise.then(function (output) {
+      output.should.equal(cylang.compile(code));
+    });
+  });
+
+  it('should compile Buffers and Uint8Arrays like strings', function () {
+    const code = 'extern "C" int puts(char const*)';
+    const expected = cylang.compile(code);
+    cylang.compile(Buffer.from(code)).should.equal(expected);
+    cylang.compile(new Uint8Array(Buffer.from(code))).should.equal(expected);
+    cylang.compile(Buffer.from('//' + code).subarray(2)).should.equal(expected);
+  });
+
+  it('should return a Buffer when asked to', function () {
+    const code = 'extern "C" int puts(char const*)';
+    const output = cylang.compile(code, { buffer: true });
+    Buffer.isBuffer(output).should.be.true();
+    output.toString().should.equal(cylang.compile(code));
+  });
+
+  it('should compile a batch of sources', function () {
+    const sources = ['x++', Buffer.from('y--'), 'extern "C" int puts(char const*)'];
+    cylang.compileAll(sources).should.eql(sources.map(source => cylang.compile(source)));
+  });
+
+  it('should report which source in a batch failed', function () {
+    (function () {
+      cylang.compileAll(['x++', 'function) {}']);
+    }).should.throw(/^syntax error, unexpected \)/, { index: 1 });
+  });
+
+  it('should tokenize source with offsets and kinds', function () {
+    const source = 'var x = 1; // one';
+    const tokens = cylang.tokenize(source);
+    tokens.kinds.should.be.an.instanceOf(Uint8Array);
+    tokens.starts.should.be.an.instanceOf(Uint32Array);
+    tokens.ends.should.be.an.instanceOf(Uint32Array);
+
+    const spans = Array.from(tokens.kinds, (kind, i) => [cylang.tokenKinds[kind], source.slice(tokens.starts[i], tokens.ends[i])]);
+    spans.should.containEql(['meta', 'var']);
+    spans.should.containEql(['constant', '1']);
+    spans.should.containEql(['comment', '// one']);
+  });
+
+  it('should tokenize from an edit offset', function () {
+    const source = 'a = 1;\nb = "\u00e9\ud83d\ude00";\nc = 3;';
+    const full = cylang.tokenize(source);
+    const from = source.indexOf('b');
+    const to = source.indexOf('c');
+    const partial = cylang.tokenize(source, { from: from, to: to });
+
+    const first = Array.from(full.starts).indexOf(from);
+    first.should.not.equal(-1);
+    Array.from(partial.starts).should.eql(Array.from(full.starts).filter(start => start >= from && start < to));
+    Array.from(partial.ends).should.eql(Array.from(full.ends).slice(first, first + partial.ends.length));
+    source.slice(partial.starts[2], partial.ends[2]).should.equal('"\u00e9\ud83d\ude00"');
+
+    (function () {
+      cylang.tokenize('x = `a\n${b}`; y', { from: 5 });
+    }).should.throw(/beginning of a line/);
+  });
+
+  it('should tokenize Buffers with byte offsets', function () {
+    const source = Buffer.from('x = "\u00e9"; y');
+    const tokens = cylang.tokenize(source);
+    source.subarray(tokens.starts[tokens.starts.length - 1], tokens.ends[tokens.ends.length - 1]).toString().should.equal('y');
+  });
 });
@@ -21,6 +21,8 @@
 
 #define __USE_EXTERN_INLINES
 
+// Analyze -p runs one unit per CY_ANALYSIS_PART in parallel; without it, everything is one unit
+#if !defined(CY_ANALYSIS_PART) || CY_ANALYSIS_PART == 0
 #include <dirent.h>
 #include <dlfcn.h>
 #include <fcntl.h>
@@ -51,14 +53,18 @@
 #if CY_OBJECTIVEC && defined(__APPLE__)
 #include <objc/runtime.h>
 #endif
+#endif
 
 #ifdef __APPLE__
+#if !defined(CY_ANALYSIS_PART) || CY_ANALYSIS_PART == 1
 #include <AddressBook/AddressBook.h>
 #include <CoreData/CoreData.h>
 #include <CoreLocation/CoreLocation.h>
 #include <MapKit/MapKit.h>
 #include <Security/Security.h>
+#endif
 
+#if !defined(CY_ANALYSIS_PART) || CY_ANALYSIS_PART == 0
 #include <dispatch/dispatch.h>
 
 #include <mach/mach.h>
@@ -68,7 +74,9 @@
 #include <mach-o/dyld.h>
 #include <mach-o/dyld_images.h>
 #include <mach-o/nlist.h>
+#endif
 
+#if !defined(CY_ANALYSIS_PART) || CY_ANALYSIS_PART == 2
 #if TARGET_OS_IPHONE
 #include <UIKit/UIKit.h>
 extern "C" UIApplication *UIApp;
@@ -76,7 +84,8 @@ extern "C" UIApplication *UIApp;
 #include <AppKit/AppKit.h>
 #endif
 #endif
+#endif
 
-#ifdef __ANDROID__
+#if (!defined(CY_ANALYSIS_PART) || CY_ANALYSIS_PART == 0) && defined(__ANDROID__)
 #include <android/log.h>
 #endif
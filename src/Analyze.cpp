@@ -19,12 +19,20 @@
 **/
 /* }}} */
 
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
 
 #include <clang-c/Index.h>
 
@@ -707,24 +715,365 @@ static CXChildVisitResult CYChildVisit(CXCursor cursor, CXCursor parent, CXClien
     return result;
 }
 
-int main(int argc, const char *argv[]) {
-    CXIndex index(clang_createIndex(0, 0));
+typedef std::vector<std::pair<std::string, uint64_t>> CYDependencies;
+
+struct CYAnalysis {
+    const char *file_;
+    std::string define_;
+    CYKeyMap keys_;
+    std::string diagnostics_;
+    double parse_;
+    double visit_;
+    double precompile_;
+
+    std::string cache_;
+    std::string precompiled_;
+    bool cached_;
+    CYDependencies dependencies_;
+
+    CYAnalysis(const char *file, const std::string &define) :
+        file_(file),
+        define_(define),
+        parse_(0),
+        visit_(0),
+        precompile_(0),
+        cached_(false)
+    {
+    }
+};
+
+// FNV-1a; this only has to notice edits, not resist them
+static uint64_t CYHash(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325) {
+    for (size_t i(0); i != size; ++i)
+        hash = (hash ^ static_cast<const uint8_t *>(data)[i]) * 0x100000001b3;
+    return hash;
+}
+
+static uint64_t CYHash(const std::string &value, uint64_t hash = 0xcbf29ce484222325) {
+    // include the terminator, so consecutive strings can't run together
+    return CYHash(value.c_str(), value.size() + 1, hash);
+}
+
+static bool CYHashFile(const char *path, uint64_t &hash) {
+    CYPool pool;
+    size_t size;
+    void *data(CYPoolFile(pool, path, &size));
+    if (data == NULL)
+        return false;
+    hash = CYHash(data, size);
+    return true;
+}
+
+static void CYInclusion(CXFile file, CXSourceLocation *stack, unsigned depth, CXClientData arg) {
+    CYDependencies &dependencies(*static_cast<CYDependencies *>(arg));
+    CYCXString path(file);
+    uint64_t hash;
+    if (CYHashFile(path, hash))
+        dependencies.push_back(std::make_pair(std::string(path), hash));
+}
+
+// a unit's cached keys are reused only while every file it included still has the same contents
+static bool CYReadDependencies(std::istream &in, CYDependencies &dependencies) {
+    std::string magic;
+    size_t count;
+    if (!std::getline(in, magic) || magic != "cycript-analysis 1" || !(in >> count))
+        return false;
+
+    for (size_t i(0); i != count; ++i) {
+        uint64_t hash, current;
+        std::string path;
+        if (!(in >> std::hex >> hash >> std::dec) || in.get() != ' ' || !std::getline(in, path))
+            return false;
+        if (!CYHashFile(path.c_str(), current) || current != hash)
+            return false;
+        dependencies.push_back(std::make_pair(path, hash));
+    }
+
+    return true;
+}
+
+static void CYWriteDependencies(std::ostream &out, const CYDependencies &dependencies) {
+    out << "cycript-analysis 1" << '\n' << dependencies.size() << '\n';
+    for (const auto &dependency : dependencies)
+        out << std::hex << dependency.second << std::dec << ' ' << dependency.first << '\n';
+}
+
+static bool CYLoadAnalysis(CYAnalysis &analysis) {
+    std::ifstream in(analysis.cache_, std::ios::binary);
+    CYDependencies dependencies;
+    if (!CYReadDependencies(in, dependencies))
+        return false;
+
+    size_t count;
+    if (!(in >> count))
+        return false;
+    for (size_t i(0); i != count; ++i) {
+        CYKey key;
+        size_t name, code;
+        if (!(in >> key.priority_ >> key.flags_ >> name >> code) || in.get() != '\n')
+            return false;
+        std::string data(name + code, '\0');
+        if (!in.read(&data[0], data.size()))
+            return false;
+        key.code_ = data.substr(name);
+        analysis.keys_[data.substr(0, name)] = key;
+    }
+
+    analysis.cached_ = true;
+    return true;
+}
+
+static void CYSaveAnalysis(const CYAnalysis &analysis) {
+    std::string temporary(analysis.cache_ + ".tmp");
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        CYWriteDependencies(out, analysis.dependencies_);
+        out << analysis.keys_.size() << '\n';
+        for (const auto &key : analysis.keys_)
+            out << key.second.priority_ << ' ' << key.second.flags_ << ' ' << key.first.size() << ' ' << key.second.code_.size() << '\n' << key.first << key.second.code_;
+        if (!out)
+            return;
+    }
+    rename(temporary.c_str(), analysis.cache_.c_str());
+}
+
+static double CYSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool CYFatal(CXTranslationUnit unit) {
+    for (unsigned i(0), e(clang_getNumDiagnostics(unit)); i != e; ++i)
+        if (clang_getDiagnosticSeverity(clang_getDiagnostic(unit, i)) >= CXDiagnostic_Fatal)
+            return true;
+    return false;
+}
+
+static bool CYPrecompile(CXIndex index, CYAnalysis &analysis, const std::vector<const char *> &flags) {
+    auto start(std::chrono::steady_clock::now());
+    CXTranslationUnit unit(clang_parseTranslationUnit(index, analysis.file_, flags.data(), flags.size(), NULL, 0, CXTranslationUnit_DetailedPreprocessingRecord | CXTranslationUnit_Incomplete | CXTranslationUnit_ForSerialization));
+    if (unit == NULL)
+        return false;
+    bool saved(!CYFatal(unit) && clang_saveTranslationUnit(unit, analysis.precompiled_.c_str(), clang_defaultSaveOptions(unit)) == CXSaveError_None);
+
+    // units loaded from a precompiled header report no inclusions, so keep the list next to it
+    analysis.dependencies_.clear();
+    if (saved) {
+        clang_getInclusions(unit, &CYInclusion, &analysis.dependencies_);
+        std::ofstream out(analysis.precompiled_ + ".deps", std::ios::binary);
+        CYWriteDependencies(out, analysis.dependencies_);
+        saved = static_cast<bool>(out);
+    }
+
+    clang_disposeTranslationUnit(unit);
+    analysis.precompile_ = CYSeconds(start);
+    return saved;
+}
+
+// the whole unit is precompiled, so it is loaded as an empty file that includes it; clang rejects
+// the precompiled header with a fatal error once any header it was built from has been modified
+static CXTranslationUnit CYLoadPrecompiled(CXIndex index, CYAnalysis &analysis, std::vector<const char *> flags) {
+    std::string file(analysis.precompiled_ + ".cpp");
+    CXUnsavedFile empty = {file.c_str(), "", 0};
+
+    bool built(false);
+    std::ifstream in(analysis.precompiled_ + ".deps", std::ios::binary);
+    if (access(analysis.precompiled_.c_str(), R_OK) != 0 || !CYReadDependencies(in, analysis.dependencies_)) {
+        if (!CYPrecompile(index, analysis, flags))
+            return NULL;
+        built = true;
+    }
 
-    const char *file(argv[1]);
+    flags.push_back("-include-pch");
+    flags.push_back(analysis.precompiled_.c_str());
+
+    for (;;) {
+        CXTranslationUnit unit(clang_parseTranslationUnit(index, file.c_str(), flags.data(), flags.size(), &empty, 1, CXTranslationUnit_DetailedPreprocessingRecord));
+        if (unit != NULL && !CYFatal(unit))
+            return unit;
+        if (unit != NULL)
+            clang_disposeTranslationUnit(unit);
+
+        if (built)
+            return NULL;
+        flags.resize(flags.size() - 2);
+        if (!CYPrecompile(index, analysis, flags))
+            return NULL;
+        flags.push_back("-include-pch");
+        flags.push_back(analysis.precompiled_.c_str());
+        built = true;
+    }
+}
+
+// each unit gets its own index and key map, so units can be analyzed on separate threads
+static void CYAnalyze(CYAnalysis &analysis, const char *const *args, int count) {
+    if (!analysis.cache_.empty() && CYLoadAnalysis(analysis))
+        return;
+    analysis.keys_.clear();
+
+    CXIndex index(clang_createIndex(0, 0));
 
-    unsigned offset(2);
+    std::vector<const char *> flags(args, args + count);
+    if (!analysis.define_.empty())
+        flags.push_back(analysis.define_.c_str());
 
-    CXTranslationUnit unit(clang_parseTranslationUnit(index, file, argv + offset, argc - offset, NULL, 0, CXTranslationUnit_DetailedPreprocessingRecord));
+    auto start(std::chrono::steady_clock::now());
+    CXTranslationUnit unit(NULL);
+    if (!analysis.precompiled_.empty())
+        unit = CYLoadPrecompiled(index, analysis, flags);
+    if (unit == NULL)
+        unit = clang_parseTranslationUnit(index, analysis.file_, flags.data(), flags.size(), NULL, 0, CXTranslationUnit_DetailedPreprocessingRecord);
+    analysis.parse_ = CYSeconds(start) - analysis.precompile_;
 
+    std::ostringstream diagnostics;
     for (unsigned i(0), e(clang_getNumDiagnostics(unit)); i != e; ++i) {
         CXDiagnostic diagnostic(clang_getDiagnostic(unit, i));
         CYCXString spelling(clang_getDiagnosticSpelling(diagnostic));
-        std::cerr << spelling << std::endl;
+        diagnostics << spelling << std::endl;
     }
+    analysis.diagnostics_ = diagnostics.str();
 
-    CYKeyMap keys;
-    CYChildBaton baton(unit, keys);
+    start = std::chrono::steady_clock::now();
+    CYChildBaton baton(unit, analysis.keys_);
     clang_visitChildren(clang_getTranslationUnitCursor(unit), &CYChildVisit, &baton);
+    analysis.visit_ = CYSeconds(start);
+
+    if (!analysis.cache_.empty()) {
+        if (analysis.dependencies_.empty())
+            clang_getInclusions(unit, &CYInclusion, &analysis.dependencies_);
+        CYSaveAnalysis(analysis);
+    }
+
+    clang_disposeTranslationUnit(unit);
+    clang_disposeIndex(index);
+}
+
+int main(int argc, const char *argv[]) {
+    unsigned jobs(std::thread::hardware_concurrency());
+    unsigned parts(0);
+    const char *cache(NULL);
+    const char *precompiled(NULL);
+    bool timing(false);
+
+    int offset(1);
+    for (; offset != argc; ++offset)
+        if (strcmp(argv[offset], "-j") == 0 && offset + 1 != argc)
+            jobs = strtoul(argv[++offset], NULL, 10);
+        else if (strcmp(argv[offset], "-p") == 0 && offset + 1 != argc)
+            parts = strtoul(argv[++offset], NULL, 10);
+        else if (strcmp(argv[offset], "-c") == 0 && offset + 1 != argc)
+            cache = argv[++offset];
+        else if (strcmp(argv[offset], "-P") == 0 && offset + 1 != argc)
+            precompiled = argv[++offset];
+        else if (strcmp(argv[offset], "-t") == 0)
+            timing = true;
+        else break;
+
+    if (offset == argc) {
+        std::cerr << "usage: " << argv[0] << " [-j jobs] [-p parts] [-c cache] [-P precompiled] [-t] file [file... --] [flags...]" << std::endl;
+        return 1;
+    }
+
+    // without the separator, the first argument is the only file; -p splits each file into units by CY_ANALYSIS_PART
+    int separator(offset);
+    while (separator != argc && strcmp(argv[separator], "--") != 0)
+        ++separator;
+    if (separator == argc)
+        separator = offset + 1;
+
+    std::vector<CYAnalysis> analyses;
+    for (int i(offset); i != separator; ++i)
+        if (parts == 0)
+            analyses.push_back(CYAnalysis(argv[i], std::string()));
+        else for (unsigned part(0); part != parts; ++part)
+            analyses.push_back(CYAnalysis(argv[i], "-DCY_ANALYSIS_PART=" + std::to_string(part)));
+    if (separator != argc && strcmp(argv[separator], "--") == 0)
+        ++separator;
+
+    const char *const *args(argv + separator);
+    int count(argc - separator);
+
+    if (cache != NULL || precompiled != NULL) {
+        // a unit is identified by its file, its part and its flags; cached keys also depend on this tool,
+        // but precompiled headers don't, so separate builds with the same flags can share them
+        uint64_t flags(CYHash(NULL, 0));
+        for (int i(0); i != count; ++i)
+            flags = CYHash(std::string(args[i]), flags);
+
+        // without this tool's own hash, keys it cached could be reused by a build that would extract different ones
+        uint64_t tool(0);
+        if (cache != NULL && !CYHashFile(argv[0], tool)) {
+            std::cerr << argv[0] << ": unable to hash this tool, so not using the cache" << std::endl;
+            cache = NULL;
+        }
+
+        for (CYAnalysis &analysis : analyses) {
+            uint64_t unit(CYHash(analysis.define_, CYHash(std::string(analysis.file_), flags)));
+            std::ostringstream name;
+            name << std::hex << std::setfill('0');
+            if (cache != NULL) {
+                name.str(std::string());
+                name << std::setw(16) << CYHash(&tool, sizeof(tool), unit);
+                analysis.cache_ = cache + ("/" + name.str()) + ".unit";
+            }
+            if (precompiled != NULL) {
+                name.str(std::string());
+                name << std::setw(16) << unit;
+                analysis.precompiled_ = precompiled + ("/" + name.str()) + ".pch";
+            }
+        }
+    }
+
+    if (jobs == 0)
+        jobs = 1;
+    if (jobs > analyses.size())
+        jobs = analyses.size();
+
+    auto start(std::chrono::steady_clock::now());
+
+    std::atomic<size_t> next(0);
+    auto worker([&]() {
+        for (size_t i; (i = next++) < analyses.size(); )
+            CYAnalyze(analyses[i], args, count);
+    });
+
+    std::vector<std::thread> threads;
+    for (unsigned i(1); i < jobs; ++i)
+        threads.push_back(std::thread(worker));
+    worker();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    double wall(CYSeconds(start));
+
+    // merge in the order the units were given, so the output doesn't depend on scheduling
+    CYKeyMap keys;
+    for (const CYAnalysis &analysis : analyses) {
+        std::cerr << analysis.diagnostics_;
+        for (CYKeyMap::const_iterator entry(analysis.keys_.begin()); entry != analysis.keys_.end(); ++entry) {
+            CYKey &key(keys[entry->first]);
+            if (key.priority_ <= entry->second.priority_)
+                key = entry->second;
+        }
+    }
+
+    // this differs between parts, and was never part of the headers
+    if (parts != 0)
+        keys.erase("CY_ANALYSIS_PART");
+
+    if (timing) {
+        for (const CYAnalysis &analysis : analyses) {
+            std::cerr << analysis.file_ << (analysis.define_.empty() ? "" : " ") << analysis.define_ << ": ";
+            if (analysis.cached_)
+                std::cerr << "cached";
+            else {
+                if (analysis.precompile_ != 0)
+                    std::cerr << "precompile " << analysis.precompile_ << "s ";
+                std::cerr << "parse " << analysis.parse_ << "s visit " << analysis.visit_ << "s";
+            }
+            std::cerr << " keys " << analysis.keys_.size() << std::endl;
+        }
+        std::cerr << analyses.size() << " units on " << jobs << " threads: " << wall << "s" << std::endl;
+    }
 
     for (CYKeyMap::const_iterator key(keys.begin()); key != keys.end(); ++key) {
         std::string code(key->second.code_);
@@ -734,8 +1083,5 @@ int main(int argc, const char *argv[]) {
         std::cout << key->first << "|" << key->second.flags_ << "\"" << code << "\"" << std::endl;
     skip:; }
 
-    clang_disposeTranslationUnit(unit);
-    clang_disposeIndex(index);
-
     return 0;
 }
@@ -24,6 +24,7 @@
 
 #include <iostream>
 
+#include "Options.hpp"
 #include "String.hpp"
 
 class CYStream :
@@ -35,6 +36,24 @@ class CYStream :
     }
 };
 
+struct CYCompileOptions {
+    CYOptions options_;
+    int debug_;
+    bool strict_;
+    bool pretty_;
+
+    CYCompileOptions() :
+        debug_(0),
+        strict_(false),
+        pretty_(false)
+    {
+    }
+};
+
+// parses, lowers and prints code to output, throwing the first error (prefixed by its location when a filename is given);
+// all state lives in pools local to the call, so it is reentrant and any number of threads may compile at once
+void CYCompile(const CYCompileOptions &options, std::streambuf &code, std::streambuf &output, const std::string &filename = "");
+
 CYUTF8String CYPoolCode(CYPool &pool, std::streambuf &stream);
 CYUTF8String CYPoolCode(CYPool &pool, CYUTF8String code);
 
@@ -25,11 +25,18 @@
 #include "JavaScript.hpp"
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdio>
 #include <complex>
 #include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <map>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #ifdef HAVE_READLINE_H
 #include <readline.h>
@@ -232,22 +239,177 @@ static void sigint(int) {
     }
 }
 
-static bool bison_;
-static bool timing_;
-static bool strict_;
-static bool pretty_;
+static uint64_t CYGetTime() {
+#ifdef __APPLE__
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0)
+        mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec spec;
+    clock_gettime(CLOCK_MONOTONIC, &spec);
+    return spec.tv_sec * UINT64_C(1000000000) + spec.tv_nsec;
+#endif
+}
+
+enum CYPhase {
+    CYPhaseScan,
+    CYPhaseParse,
+    CYPhaseReplace,
+    CYPhaseOutput,
+    CYPhaseExecute,
+    CYPhaseCount,
+};
+
+static const char *const CYPhaseNames[CYPhaseCount] = {
+    "scan",
+    "parse",
+    "replace",
+    "output",
+    "execute",
+};
+
+struct CYSample {
+    uint64_t time_[CYPhaseCount];
+    size_t pool_[CYPhaseCount];
+
+    CYSample() {
+        memset(time_, 0, sizeof(time_));
+        memset(pool_, 0, sizeof(pool_));
+    }
+};
+
+// parse includes the scanner, which is pulled token by token; scan is a separate scanner-only pass
+class CYProfilePhase {
+  private:
+    CYSample &sample_;
+    CYPhase phase_;
+    CYPool &pool_;
+    uint64_t time_;
+    size_t size_;
+
+  public:
+    CYProfilePhase(CYSample &sample, CYPhase phase, CYPool &pool) :
+        sample_(sample),
+        phase_(phase),
+        pool_(pool),
+        time_(CYGetTime()),
+        size_(pool.Allocated())
+    {
+    }
+
+    ~CYProfilePhase() {
+        sample_.time_[phase_] += CYGetTime() - time_;
+        sample_.pool_[phase_] += pool_.Allocated() - size_;
+    }
+};
+
+template <typename Type_>
+static Type_ CYPercentile(std::vector<Type_> &values, unsigned percent) {
+    std::sort(values.begin(), values.end());
+    size_t rank((values.size() * percent + 99) / 100);
+    return values[rank == 0 ? 0 : rank - 1];
+}
+
+static void CYPoolReport(std::ostream &out, const CYPoolStatistics &statistics, bool json) {
+    if (json)
+        out << "{\"requested\":" << statistics.requested_ << ",\"wasted\":" << statistics.wasted_ << ",\"blocks\":" << statistics.blocks_ << ",\"recycled\":" << statistics.recycled_ << ",\"cleaners\":" << statistics.cleaners_ << "}";
+    else
+        out << "requested " << statistics.requested_ << "B  wasted " << statistics.wasted_ << "B  blocks " << statistics.blocks_ << " (" << statistics.recycled_ << " recycled)  cleaners " << statistics.cleaners_;
+}
+
+// CYStringify emits \x and \0 escapes, which JSON does not have, so this only escapes what JSON requires
+static void CYJSONString(std::ostream &out, const char *data) {
+    out << '"';
+    for (const char *value(data); *value != '\0'; ++value)
+        switch (uint8_t next = *value) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (next >= 0x20)
+                    out << *value;
+                else
+                    out << "\\u" << std::setbase(16) << std::setw(4) << std::setfill('0') << unsigned(next) << std::setbase(10) << std::setfill(' ');
+        }
+    out << '"';
+}
 
-void Setup(CYDriver &driver) {
-    if (bison_)
-        driver.debug_ = 1;
-    if (strict_)
-        driver.strict_ = true;
+static void CYProfileReport(std::ostream &out, const char *script, const std::vector<CYSample> &samples, const CYPoolStatistics &pools, bool json) {
+    static const unsigned percents[] = {0, 50, 90, 99, 100};
+    static const char *const labels[] = {"min", "p50", "p90", "p99", "max"};
+    static const size_t count(sizeof(percents) / sizeof(percents[0]));
+
+    if (json) {
+        out << "{\"input\":";
+        CYJSONString(out, script);
+        out << ",\"iterations\":" << samples.size() << ",\"phases\":{";
+    } else {
+        out << script << " (" << samples.size() << " iterations, times in microseconds)" << std::endl;
+        out << "phase   ";
+        for (size_t i(0); i != count; ++i)
+            out << '\t' << labels[i];
+        out << "\tpool" << std::endl;
+    }
+
+    for (unsigned phase(0); phase != CYPhaseCount; ++phase) {
+        std::vector<uint64_t> times;
+        std::vector<size_t> pools;
+        for (std::vector<CYSample>::const_iterator sample(samples.begin()); sample != samples.end(); ++sample) {
+            times.push_back(sample->time_[phase]);
+            pools.push_back(sample->pool_[phase]);
+        }
+
+        if (json) {
+            if (phase != 0)
+                out << ',';
+            out << '"' << CYPhaseNames[phase] << "\":{\"time\":{";
+            for (size_t i(0); i != count; ++i)
+                out << (i == 0 ? "" : ",") << '"' << labels[i] << "\":" << CYPercentile(times, percents[i]);
+            out << "},\"pool\":{";
+            for (size_t i(0); i != count; ++i)
+                out << (i == 0 ? "" : ",") << '"' << labels[i] << "\":" << CYPercentile(pools, percents[i]);
+            out << "}}";
+        } else {
+            out << CYPhaseNames[phase] << std::string(8 - strlen(CYPhaseNames[phase]), ' ');
+            for (size_t i(0); i != count; ++i)
+                out << '\t' << std::fixed << std::setprecision(1) << CYPercentile(times, percents[i]) / 1000.0;
+            out << '\t' << CYPercentile(pools, 50) << std::endl;
+        }
+    }
+
+    if (json) {
+        out << "},\"pools\":";
+        CYPoolReport(out, pools, true);
+        out << "}" << std::endl;
+    } else {
+        out << "pools   \t";
+        CYPoolReport(out, pools, false);
+        out << std::endl;
+    }
 }
 
-void Setup(CYOutput &out, CYDriver &driver, CYOptions &options, bool lower) {
-    out.pretty_ = pretty_;
-    if (lower)
-        driver.Replace(options);
+static void CYProfilePrint(std::ostream &out, const CYSample &sample) {
+    for (unsigned phase(0); phase != CYPhaseCount; ++phase) {
+        if (phase != 0)
+            out << "  ";
+        out << CYPhaseNames[phase] << ' ' << std::fixed << std::setprecision(3) << sample.time_[phase] / 1000000.0 << "ms/" << sample.pool_[phase] << 'B';
+    }
+    out << std::endl;
+}
+
+void Setup(CYDriver &driver, const CYCompileOptions &options) {
+    driver.debug_ = options.debug_;
+    driver.strict_ = options.strict_;
+}
+
+void Setup(CYOutput &out, CYDriver &driver, CYCompileOptions &options, bool lower, CYSample &sample) {
+    out.pretty_ = options.pretty_;
+    if (lower) {
+        CYProfilePhase phase(sample, CYPhaseReplace, driver.pool_);
+        driver.Replace(options.options_);
+    }
 }
 
 static CYUTF8String Run(CYPool &pool, CYUTF8String code) {
@@ -590,7 +752,7 @@ static void CYOutputRun(const std::string &code, bool reparse = false) {
     Output(Run(pool, code), &std::cout, reparse);
 }
 
-static void Console(CYOptions &options) {
+static void Console(CYCompileOptions &options) {
     std::string basedir;
 #ifdef __ANDROID__
     basedir = "/data/local/tmp";
@@ -618,6 +780,7 @@ static void Console(CYOptions &options) {
     bool bypass(false);
     bool debug(false);
     bool lower(true);
+    bool profile(false);
     bool reparse(false);
 
     out_ = &std::cout;
@@ -689,6 +852,12 @@ static void Console(CYOptions &options) {
             } else if (data == "lower") {
                 lower = !lower;
                 *out_ << "lower == " << (lower ? "true" : "false") << std::endl;
+            } else if (data == "pool") {
+                CYPoolReport(*out_, CYPool::Totals(), false);
+                *out_ << std::endl;
+            } else if (data == "profile") {
+                profile = !profile;
+                *out_ << "profile == " << (profile ? "true" : "false") << std::endl;
             } else if (data == "reparse") {
                 reparse = !reparse;
                 *out_ << "reparse == " << (reparse ? "true" : "false") << std::endl;
@@ -697,6 +866,8 @@ static void Console(CYOptions &options) {
             continue;
         }
 
+        CYSample sample;
+
         std::string code;
         if (bypass)
             code = command;
@@ -704,10 +875,20 @@ static void Console(CYOptions &options) {
             std::stringbuf stream(command);
 
             CYPool pool;
+            if (profile) {
+                CYProfilePhase phase(sample, CYPhaseScan, pool);
+                CYLexerScan(pool, command.data(), command.size());
+            }
+
             CYDriver driver(pool, stream);
-            Setup(driver);
+            Setup(driver, options);
 
-            if (driver.Parse() || !driver.errors_.empty()) {
+            bool failed; {
+                CYProfilePhase phase(sample, CYPhaseParse, pool);
+                failed = driver.Parse();
+            }
+
+            if (failed || !driver.errors_.empty()) {
                 for (CYDriver::Errors::const_iterator error(driver.errors_.begin()); error != driver.errors_.end(); ++error) {
                     CYPosition begin(error->location_.begin);
                     CYPosition end(error->location_.end);
@@ -739,9 +920,11 @@ static void Console(CYOptions &options) {
                 continue;
 
             std::stringbuf str;
-            CYOutput out(str, options);
-            Setup(out, driver, options, lower);
-            out << *driver.script_;
+            CYOutput out(str, options.options_);
+            Setup(out, driver, options, lower, sample); {
+                CYProfilePhase phase(sample, CYPhaseOutput, pool);
+                out << *driver.script_;
+            }
             code = str.str();
         } catch (const CYException &error) {
             CYPool pool;
@@ -755,25 +938,180 @@ static void Console(CYOptions &options) {
             std::cout << std::endl;
         }
 
-        CYOutputRun(code, reparse);
+        CYPool pool;
+        CYUTF8String json; {
+            CYProfilePhase phase(sample, CYPhaseExecute, pool);
+            json = Run(pool, code);
+        }
+        Output(json, &std::cout, reparse);
+
+        if (profile)
+            CYProfilePrint(*out_, sample);
     }
 }
 
-static uint64_t CYGetTime() {
-#ifdef __APPLE__
-    return mach_absolute_time();
-#else
-    struct timespec spec;
-    clock_gettime(CLOCK_MONOTONIC, &spec);
-    return spec.tv_sec * UINT64_C(1000000000) + spec.tv_nsec;
-#endif
+static bool Profile(CYSample &sample, const std::string &code, const char *script, CYCompileOptions &options, bool execute) {
+    CYPool pool;
+
+    {
+        CYProfilePhase phase(sample, CYPhaseScan, pool);
+        CYLexerScan(pool, code.data(), code.size());
+    }
+
+    std::stringbuf stream(code);
+    CYDriver driver(pool, stream, script);
+    Setup(driver, options);
+
+    bool failed; {
+        CYProfilePhase phase(sample, CYPhaseParse, pool);
+        failed = driver.Parse();
+    }
+
+    if (failed || !driver.errors_.empty()) {
+        for (CYDriver::Errors::const_iterator i(driver.errors_.begin()); i != driver.errors_.end(); ++i)
+            std::cerr << i->location_.begin << ": " << i->message_ << std::endl;
+        return false;
+    }
+
+    if (driver.script_ == NULL)
+        return true;
+
+    std::stringbuf str;
+    CYOutput out(str, options.options_);
+    Setup(out, driver, options, true, sample); {
+        CYProfilePhase phase(sample, CYPhaseOutput, pool);
+        out << *driver.script_;
+    }
+
+    if (execute) {
+        CYProfilePhase phase(sample, CYPhaseExecute, pool);
+        Run(pool, str.str());
+    }
+
+    return true;
+}
+
+// the options that change what a file compiles to; outputs compiled under different ones are never up to date
+static std::string CYCompileStamp(const CYCompileOptions &options) {
+    std::ostringstream stamp;
+    stamp << "standard " << (options.options_.standard_ == CYStandardES2015 ? "es2015" : "es5") << '\n';
+    stamp << "minify " << options.options_.minify_ << '\n';
+    stamp << "verbose " << options.options_.verbose_ << '\n';
+    stamp << "strict " << options.strict_ << '\n';
+    stamp << "pretty " << options.pretty_ << '\n';
+    return stamp.str();
+}
+
+// writes through a temporary file in the same directory, so an interrupted write never leaves a truncated output behind
+static bool CYWriteFile(const std::string &path, const std::string &data) {
+    std::ostringstream temporary;
+    temporary << path << "." << getpid() << ".tmp";
+    std::string name(temporary.str());
+
+    std::ofstream output(name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    output << data;
+    output.close();
+    if (output.fail() || rename(name.c_str(), path.c_str()) != 0) {
+        unlink(name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// compiles each file to directory/<name>.js on jobs threads, skipping outputs newer than their input when the options
+// match those recorded in directory/.cycript; threads take the next file from a shared counter, so a slow file never
+// holds up the rest, and errors are reported in input order
+static bool CYCompileFiles(const CYCompileOptions &options, const char *directory, unsigned jobs, int count, char * const files[]) {
+    std::vector<std::string> paths(count);
+    std::map<std::string, const char *> outputs;
+    for (int index(0); index != count; ++index) {
+        const char *file(files[index]);
+
+        const char *slash(strrchr(file, '/'));
+        std::string name(slash == NULL ? file : slash + 1);
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".cy") == 0)
+            name.resize(name.size() - 3);
+        paths[index] = std::string(directory) + "/" + name + ".js";
+
+        const char *&other(outputs[paths[index]]);
+        if (other != NULL) {
+            std::cerr << other << " and " << file << " both compile to " << paths[index] << std::endl;
+            return false;
+        }
+        other = file;
+    }
+
+    std::string stamp(CYCompileStamp(options));
+    std::string record(std::string(directory) + "/.cycript");
+    std::ifstream recorded(record.c_str(), std::ios::in | std::ios::binary);
+    std::string previous((std::istreambuf_iterator<char>(recorded)), std::istreambuf_iterator<char>());
+    bool current(previous == stamp);
+
+    std::vector<std::string> errors(count);
+    std::atomic<int> next(0);
+
+    auto work([&]() {
+        for (int index; (index = next++) < count; ) {
+            const char *file(files[index]);
+            const std::string &path(paths[index]);
+
+            std::filebuf input;
+            if (input.open(file, std::ios::in | std::ios::binary) == NULL) {
+                errors[index] = std::string(file) + ": unable to open";
+                continue;
+            }
+
+            struct stat source, target;
+            if (current && stat(file, &source) == 0 && stat(path.c_str(), &target) == 0 && target.st_mtime > source.st_mtime)
+                continue;
+
+            std::stringbuf code;
+            try {
+                CYCompile(options, input, code, file);
+            } catch (const CYException &error) {
+                CYPool pool;
+                errors[index] = error.PoolCString(pool);
+                continue;
+            }
+
+            if (!CYWriteFile(path, code.str()))
+                errors[index] = path + ": unable to write";
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (unsigned i(1); i < jobs && i < unsigned(count); ++i)
+        threads.push_back(std::thread(work));
+    work();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    bool failed(false);
+    for (const std::string &error : errors)
+        if (!error.empty()) {
+            std::cerr << error << std::endl;
+            failed = true;
+        }
+
+    // only once every output is from these options: after a failure, the next run must still recompile everything
+    if (!failed && !current && !CYWriteFile(record, stamp)) {
+        std::cerr << record << ": unable to write" << std::endl;
+        failed = true;
+    }
+
+    return !failed;
 }
 
 int Main(int argc, char * const argv[], char const * const envp[]) {
     bool tty(isatty(STDIN_FILENO));
     bool compile(false);
     bool target(false);
-    CYOptions options;
+    unsigned timing(0);
+    bool json(false);
+    unsigned jobs(0);
+    const char *directory(NULL);
+    CYCompileOptions options;
 
     append_history$ = (int (*)(int, const char *)) (dlsym(RTLD_DEFAULT, "append_history"));
 
@@ -791,19 +1129,25 @@ int Main(int argc, char * const argv[], char const * const envp[]) {
         int option(getopt_long(argc, argv,
             "c"
             "g:"
+            "j:"
             "n:"
             "d:"
+            "o:"
             "p:"
             "r:"
             "s"
+            "t:"
         , (const struct option[]) {
             {NULL, no_argument, NULL, 'c'},
             {NULL, required_argument, NULL, 'g'},
+            {NULL, required_argument, NULL, 'j'},
             {NULL, required_argument, NULL, 'n'},
             {NULL, required_argument, NULL, 'd'},
+            {NULL, required_argument, NULL, 'o'},
             {NULL, required_argument, NULL, 'p'},
             {NULL, required_argument, NULL, 'r'},
             {NULL, no_argument, NULL, 's'},
+            {NULL, required_argument, NULL, 't'},
         {0, 0, 0, 0}}, NULL));
 
         switch (option) {
@@ -818,6 +1162,7 @@ int Main(int argc, char * const argv[], char const * const envp[]) {
                     " [-r <host:port>]"
                     " [-p <pid|name>]"
                     " [<script> [<arg>...]]\n"
+                    "       cycript -c [-t <es5|es2015>] [-j <jobs>] -o <directory> <script>...\n"
                 );
                 return 1;
 
@@ -837,21 +1182,41 @@ int Main(int argc, char * const argv[], char const * const envp[]) {
             case 'g':
                 if (false);
                 else if (strcmp(optarg, "rename") == 0)
-                    options.verbose_ = true;
+                    options.options_.verbose_ = true;
                 else if (strcmp(optarg, "bison") == 0)
-                    bison_ = true;
+                    options.debug_ = 1;
                 else if (strcmp(optarg, "timing") == 0)
-                    timing_ = true;
+                    timing = 100;
+                else if (strncmp(optarg, "timing=", 7) == 0) {
+                    timing = strtoul(optarg + 7, NULL, 10);
+                    if (timing == 0) {
+                        fprintf(stderr, "invalid iteration count for -g timing\n");
+                        return 1;
+                    }
+                } else if (strcmp(optarg, "json") == 0)
+                    json = true;
                 else {
                     fprintf(stderr, "invalid name for -g\n");
                     return 1;
                 }
             break;
 
+            case 'j':
+                jobs = strtoul(optarg, NULL, 10);
+                if (jobs == 0) {
+                    fprintf(stderr, "invalid job count for -j\n");
+                    return 1;
+                }
+            break;
+
+            case 'o':
+                directory = optarg;
+            break;
+
             case 'n':
                 if (false);
                 else if (strcmp(optarg, "minify") == 0)
-                    pretty_ = true;
+                    options.options_.minify_ = true;
                 else {
                     fprintf(stderr, "invalid name for -n\n");
                     return 1;
@@ -871,7 +1236,19 @@ int Main(int argc, char * const argv[], char const * const envp[]) {
             goto target;
 
             case 's':
-                strict_ = true;
+                options.strict_ = true;
+            break;
+
+            case 't':
+                if (false);
+                else if (strcmp(optarg, "es5") == 0)
+                    options.options_.standard_ = CYStandardES5;
+                else if (strcmp(optarg, "es2015") == 0)
+                    options.options_.standard_ = CYStandardES2015;
+                else {
+                    fprintf(stderr, "invalid standard for -t\n");
+                    return 1;
+                }
             break;
 
             default:
@@ -883,6 +1260,20 @@ int Main(int argc, char * const argv[], char const * const envp[]) {
     argc -= optind;
     argv += optind;
 
+    if (directory != NULL || jobs != 0) {
+        if (!compile) {
+            fprintf(stderr, "-j and -o may only be used with -c\n");
+            return 1;
+        } else if (directory == NULL) {
+            fprintf(stderr, "-j may only be used with -o\n");
+            return 1;
+        }
+
+        if (jobs == 0)
+            jobs = std::max(std::thread::hardware_concurrency(), 1u);
+        return CYCompileFiles(options, directory, jobs, argc, argv) ? 0 : 1;
+    }
+
     const char *script;
 
     if (process != NULL && argc > 1) {
@@ -919,47 +1310,37 @@ int Main(int argc, char * const argv[], char const * const envp[]) {
             _assert(!stream->fail());
         }
 
-        if (timing_) {
+        if (timing != 0) {
             std::stringbuf buffer;
             stream->get(buffer, '\0');
-            _assert(!stream->fail());
+            std::string code(buffer.str());
 
-            double average(0);
-            int samples(-50);
-            uint64_t start(CYGetTime());
+            CYPoolStatistics before(CYPool::Totals());
 
-            for (;;) {
-                stream = new std::istringstream(buffer.str());
-
-                CYPool pool;
-                CYDriver driver(pool, *stream->rdbuf(), script);
-                Setup(driver);
-
-                uint64_t begin(CYGetTime());
-                driver.Parse();
-                uint64_t end(CYGetTime());
-
-                delete stream;
-
-                average += (end - begin - average) / ++samples;
-
-                uint64_t now(CYGetTime());
-                if (samples == 0)
-                    average = 0;
-                else if ((now - start) / 1000000000 >= 1)
-                    std::cout << std::fixed << average << '\t' << (end - begin) << '\t' << samples << std::endl;
-                else continue;
-
-                start = now;
+            std::vector<CYSample> samples;
+            for (unsigned i(0); i != timing; ++i) {
+                CYSample sample;
+                if (!Profile(sample, code, script, options, !compile))
+                    return 1;
+                samples.push_back(sample);
             }
 
-            stream = new std::istringstream(buffer.str());
-            std::cin.get();
+            const CYPoolStatistics &after(CYPool::Totals());
+            CYPoolStatistics pools;
+            pools.requested_ = (after.requested_ - before.requested_) / timing;
+            pools.wasted_ = (after.wasted_ - before.wasted_) / timing;
+            pools.blocks_ = (after.blocks_ - before.blocks_) / timing;
+            pools.recycled_ = (after.recycled_ - before.recycled_) / timing;
+            pools.cleaners_ = (after.cleaners_ - before.cleaners_) / timing;
+
+            CYProfileReport(std::cout, script, samples, pools, json);
+            CYDetach();
+            return 0;
         }
 
         CYPool pool;
         CYDriver driver(pool, *stream->rdbuf(), script);
-        Setup(driver);
+        Setup(driver, options);
 
         bool failed(driver.Parse());
 
@@ -969,8 +1350,9 @@ int Main(int argc, char * const argv[], char const * const envp[]) {
             return 1;
         } else if (driver.script_ != NULL) {
             std::stringbuf str;
-            CYOutput out(str, options);
-            Setup(out, driver, options, true);
+            CYOutput out(str, options.options_);
+            CYSample sample;
+            Setup(out, driver, options, true, sample);
             out << *driver.script_;
             std::string code(str.str());
             if (compile)
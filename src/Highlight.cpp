@@ -110,3 +110,74 @@ _visible void CYLexerHighlight(const char *data, size_t size, std::ostream &outp
 
     output.write(data + offset, size - offset);
 }
+
+_visible size_t CYLexerScan(CYPool &pool, const char *data, size_t size) {
+    CYStream stream(data, data + size);
+    CYDriver driver(pool, stream);
+    driver.highlight_ = true;
+
+    size_t count(0);
+
+    hi::Value highlight;
+    CYLocation location;
+
+    while (CYLexerHighlight(highlight, location, driver.scanner_))
+        ++count;
+
+    return count;
+}
+
+// advances offset to target the way the scanner counts lines, but never past the end of the data
+static void Advance(const char *data, size_t size, size_t &offset, CYPosition &current, CYPosition target) {
+    while (offset != size && (current.line < target.line || (current.line == target.line && current.column < target.column))) {
+        if (data[offset++] == '\n')
+            current.Lines();
+        else
+            current.Columns();
+    }
+}
+
+_visible size_t CYLexerTokenize(CYPool &pool, const char *data, size_t size, size_t from, size_t to, CYLexerToken *&tokens) {
+    _assert(from <= size);
+    // the scanner starts fresh, so it can't know about a comment, string or template it started inside of
+    if (from != 0 && data[from - 1] != '\n')
+        CYThrow("tokenizing must start at the beginning of a line, not at offset %zu", from);
+
+    CYLocalPool local;
+
+    CYStream stream(data + from, data + size);
+    CYDriver driver(local, stream);
+    driver.highlight_ = true;
+
+    size_t count(0);
+    size_t capacity(0);
+    tokens = NULL;
+
+    size_t offset(from);
+    CYPosition current;
+
+    hi::Value highlight;
+    CYLocation location;
+
+    while (CYLexerHighlight(highlight, location, driver.scanner_)) {
+        Advance(data, size, offset, current, location.begin);
+        if (offset >= to)
+            break;
+
+        if (count == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            CYLexerToken *copy(pool.malloc<CYLexerToken>(capacity * sizeof(CYLexerToken)));
+            if (count != 0)
+                memcpy(copy, tokens, count * sizeof(CYLexerToken));
+            tokens = copy;
+        }
+
+        CYLexerToken &token(tokens[count++]);
+        token.highlight_ = highlight;
+        token.begin_ = offset;
+        Advance(data, size, offset, current, location.end);
+        token.end_ = offset;
+    }
+
+    return count;
+}
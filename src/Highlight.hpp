@@ -24,6 +24,8 @@
 
 #include <iostream>
 
+class CYPool;
+
 namespace hi { enum Value {
     Comment,
     Constant,
@@ -39,6 +41,19 @@ namespace hi { enum Value {
 }; }
 
 void CYLexerHighlight(const char *data, size_t size, std::ostream &output, bool ignore = false);
+size_t CYLexerScan(CYPool &pool, const char *data, size_t size);
+
+struct CYLexerToken {
+    hi::Value highlight_;
+    size_t begin_;
+    size_t end_;
+};
+
+// scans data from offset from and stops at the first token starting at or after to; token offsets are absolute, so an
+// editor can splice the result over the tokens it had from there onward. no scanner state is carried over, so from must
+// be the start of a line (this throws otherwise) that begins a statement outside any comment, string or template: a
+// '/' there is taken to start a regular expression, and a '}' to close a block rather than a template substitution
+size_t CYLexerTokenize(CYPool &pool, const char *data, size_t size, size_t from, size_t to, CYLexerToken *&tokens);
 
 const char CYIgnoreStart = '\x01';
 const char CYIgnoreEnd = '\x02';
@@ -125,23 +125,37 @@ _visible bool CYStartsWith(const CYUTF8String &haystack, const CYUTF8String &nee
     return haystack.size >= needle.size && strncmp(haystack.data, needle.data, needle.size) == 0;
 }
 
-CYUTF8String CYPoolCode(CYPool &pool, std::streambuf &stream) {
-    CYLocalPool local;
-    CYDriver driver(local, stream);
-
-    if (driver.Parse()) {
-        if (!driver.errors_.empty())
-            CYThrow("%s", driver.errors_.front().message_.c_str());
-        CYThrow("syntax error");
+_visible void CYCompile(const CYCompileOptions &options, std::streambuf &code, std::streambuf &output, const std::string &filename) {
+    CYLocalPool pool;
+    CYDriver driver(pool, code, filename);
+    driver.debug_ = options.debug_;
+    driver.strict_ = options.strict_;
+
+    if (driver.Parse() || !driver.errors_.empty()) {
+        if (driver.errors_.empty())
+            CYThrow("syntax error");
+        const CYDriver::Error &error(driver.errors_.front());
+        if (filename.empty())
+            CYThrow("%s", error.message_.c_str());
+        std::ostringstream location;
+        location << error.location_.begin;
+        CYThrow("%s: %s", location.str().c_str(), error.message_.c_str());
     }
 
-    CYOptions options;
-    CYContext context(options);
-    driver.script_->Replace(context);
+    if (driver.script_ == NULL)
+        return;
 
-    std::stringbuf str;
-    CYOutput out(str, options);
+    CYOptions lower(options.options_);
+    driver.Replace(lower);
+
+    CYOutput out(output, lower);
+    out.pretty_ = options.pretty_;
     out << *driver.script_;
+}
+
+CYUTF8String CYPoolCode(CYPool &pool, std::streambuf &stream) {
+    std::stringbuf str;
+    CYCompile(CYCompileOptions(), stream, str);
     return pool.strdup(str.str().c_str());
 }
 
@@ -149,8 +163,3 @@ CYUTF8String CYPoolCode(CYPool &pool, CYUTF8String code) {
     CYStream stream(code.data, code.data + code.size);
     return CYPoolCode(pool, stream);
 }
-
-CYPool &CYGetGlobalPool() {
-    static CYPool pool;
-    return pool;
-}
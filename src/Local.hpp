@@ -22,6 +22,13 @@
 #ifndef CYCRIPT_LOCAL_HPP
 #define CYCRIPT_LOCAL_HPP
 
+// called with each thread's value as the thread exits; specialize it for values that belong to their thread
+template <typename Type_>
+struct CYLocalExit {
+    static void Exit(Type_ *) {
+    }
+};
+
 #ifdef _WIN32
 
 #define WIN32_LEAN_AND_MEAN
@@ -36,13 +43,19 @@ class CYLocal {
 
     Type_ *last_;
 
+    static VOID NTAPI Exit_(PVOID value) {
+        if (value != NULL)
+            CYLocalExit<Type_>::Exit(static_cast<Type_ *>(value));
+    }
+
   protected:
     static _finline void Set(Type_ *value) {
-        _assert(::TlsSetValue(key_, value));
+        _assert(::FlsSetValue(key_, value));
     }
 
+    // unlike TLS, FLS calls back when the thread exits
     static CYLocalKey Key_() {
-        return ::TlsAlloc();
+        return ::FlsAlloc(&Exit_);
     }
 
   public:
@@ -56,7 +69,7 @@ class CYLocal {
     }
 
     static _finline Type_ *Get() {
-        return static_cast<Type_ *>(::TlsGetValue(key_));
+        return static_cast<Type_ *>(::FlsGetValue(key_));
     }
 };
 
@@ -73,6 +86,10 @@ class CYLocal {
 
     Type_ *last_;
 
+    static void Exit_(void *value) {
+        CYLocalExit<Type_>::Exit(static_cast<Type_ *>(value));
+    }
+
   protected:
     static _finline void Set(Type_ *value) {
         _assert(::pthread_setspecific(key_, value) == 0);
@@ -80,7 +97,7 @@ class CYLocal {
 
     static CYLocalKey Key_() {
         CYLocalKey key;
-        ::pthread_key_create(&key, NULL);
+        ::pthread_key_create(&key, &Exit_);
         return key;
     }
 
@@ -19,14 +19,19 @@
 **/
 /* }}} */
 
-#include <sstream>
-
 #include "Replace.hpp"
 
 #include "ObjectiveC/Syntax.hpp"
 
+// a type fixed at compile time is spelled as its encoding, which CYAdd then folds into the neighbouring literals
+static CYExpression *TypeEncoding(CYContext &context, CYType *type) {
+    if (const char *encoding = type->Encoding(context, false))
+        return $S(encoding);
+    return $C0($M(type->Replace(context), $S("toString")));
+}
+
 static CYExpression *MessageType(CYContext &context, CYType *type, CYMessageParameter *next, CYExpression *extra = NULL) {
-    CYExpression *left($C0($M(type->Replace(context), $S("toString"))));
+    CYExpression *left(TypeEncoding(context, type));
     if (extra != NULL)
         left = $ CYAdd(left, extra);
 
@@ -70,7 +75,7 @@ CYStatement *CYImplementationField::Replace(CYContext &context) const { $T(NULL)
     CYVariable *cyn($V("$cyn"));
     CYVariable *cyt($V("$cyt"));
 
-    CYExpression *type($C0($M(type_->Replace(context), $S("toString"))));
+    CYExpression *type(TypeEncoding(context, type_));
 
     return $ CYBlock($$->*
         $E($ CYAssign(cyt, type))->*
@@ -167,23 +172,43 @@ CYStatement *CYProtocol::Replace(CYContext &context) const { $T(NULL)
     );
 }
 
+// each distinct selector is registered once, on first use, into a script-level variable named after it, so sends in
+// loops and hooks stop calling into the runtime; naming it after the selector keeps it valid across console lines, and
+// escaping '$' as "$$" and ':' as "$_" keeps distinct selectors (such as a:b and a$b) from sharing a name
 CYTarget *CYSelector::Replace(CYContext &context) {
-    return $C1($V("sel_registerName"), parts_->Replace(context));
+    CYString *name(parts_->Replace(context));
+
+    CYBuffer buffer($pool);
+    buffer << "$cyS";
+    for (const char *value(name->value_), *end(value + name->size_); value != end; ++value)
+        switch (*value) {
+            case '$': buffer << "$$"; break;
+            case ':': buffer << "$_"; break;
+            default: buffer << *value; break;
+        }
+    CYIdentifier *identifier($ CYIdentifier(buffer.Finish()));
+
+    CYScope *scope(context.scope_);
+    while (scope->parent_ != NULL)
+        scope = scope->parent_;
+    scope->Declare(context, identifier, CYIdentifierVariable);
+
+    return $ CYParenthetical($ CYLogicalOr($V(identifier), $ CYAssign($V(identifier), $C1($V("sel_registerName"), name))));
 }
 
 CYString *CYSelectorPart::Replace(CYContext &context) {
-    std::ostringstream str;
+    CYBuffer name($pool);
     CYForEach (part, this) {
         if (part->name_ != NULL)
-            str << part->name_->Word();
+            name << part->name_->Word();
         if (part->value_)
-            str << ':';
+            name << ':';
     }
-    return $S($pool.strdup(str.str().c_str()));
+    size_t size(name.Size());
+    return $S(name.Finish(), size);
 }
 
 CYTarget *CYSendDirect::Replace(CYContext &context) {
-    std::ostringstream name;
     CYArgument **argument(&arguments_);
     CYSelectorPart *selector(NULL), *current(NULL);
 
@@ -22,11 +22,22 @@
 #ifndef CYCRIPT_OPTIONS_HPP
 #define CYCRIPT_OPTIONS_HPP
 
+// the oldest language the output has to run on: later standards keep the constructs they support natively
+enum CYStandard {
+    CYStandardES5,
+    CYStandardES2015,
+};
+
 struct CYOptions {
     bool verbose_;
+    CYStandard standard_;
+    // drop dead branches, unreachable statements and unused locals, for output that is shipped rather than read
+    bool minify_;
 
     CYOptions() :
-        verbose_(false)
+        verbose_(false),
+        standard_(CYStandardES5),
+        minify_(false)
     {
     }
 };
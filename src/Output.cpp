@@ -31,6 +31,8 @@ enum CYStringType {
     CYStringTypeTemplate,
 };
 
+static void CYStringifyBody(std::ostringstream &str, const char *data, size_t size, CYStringifyMode mode, CYStringType type, bool split);
+
 void CYStringify(std::ostringstream &str, const char *data, size_t size, CYStringifyMode mode) {
     if (size == 0) {
         str << "\"\"";
@@ -77,6 +79,20 @@ void CYStringify(std::ostringstream &str, const char *data, size_t size, CYStrin
     }
 
     str << border;
+    CYStringifyBody(str, data, size, mode, type, split);
+    str << border;
+
+    if (parens)
+        str << ')';
+}
+
+static void CYStringifyBody(std::ostringstream &str, const char *data, size_t size, CYStringifyMode mode, CYStringType type, bool split) {
+    char border;
+    switch (type) {
+        case CYStringTypeSingle: border = '\''; break;
+        case CYStringTypeDouble: border = '"'; break;
+        case CYStringTypeTemplate: border = '`'; break;
+    }
 
     bool space(false);
 
@@ -167,11 +183,6 @@ void CYStringify(std::ostringstream &str, const char *data, size_t size, CYStrin
                     }
                 }
         } space = false; }
-
-    str << border;
-
-    if (parens)
-        str << ')';
 }
 
 void CYNumerify(std::ostringstream &str, double value) {
@@ -386,8 +397,26 @@ void CYClassTail::Output(CYOutput &out) const {
     out << '{' << '\n';
     ++out.indent_;
 
+    if (constructor_ != NULL) {
+        out << '\t' << "constructor";
+        constructor_->CYFunction::Output(out);
+        out << '\n';
+    }
+
+    CYForEach (member, static_) {
+        out << '\t' << "static" << ' ';
+        member->Define(out);
+        out << '\n';
+    }
+
+    CYForEach (member, instance_) {
+        out << '\t';
+        member->Define(out);
+        out << '\n';
+    }
+
     --out.indent_;
-    out << '}';
+    out << '\t' << '}';
 }
 
 void CYCompound::Output(CYOutput &out, CYFlags flags) const {
@@ -554,7 +583,12 @@ void CYExternalExpression::Output(CYOutput &out, CYFlags flags) const {
 }
 
 void CYFatArrow::Output(CYOutput &out, CYFlags flags) const {
-    out << '(' << parameters_ << ')' << ' ' << "=>" << ' ' << '{' << code_ << '}';
+    out << '(' << parameters_ << ')' << ' ' << "=>" << ' ';
+    out << '{' << '\n';
+    ++out.indent_;
+    out << code_;
+    --out.indent_;
+    out << '\t' << '}';
 }
 
 void CYFinally::Output(CYOutput &out) const {
@@ -752,7 +786,23 @@ void CYStatement::Output(CYOutput &out) const {
 }
 
 void CYTemplate::Output(CYOutput &out, CYFlags flags) const {
-    _assert(false);
+    // every chunk carries its delimiters, so CYOutput never sees a lone space it would drop
+    std::ostringstream str;
+    str << '`';
+    CYStringifyBody(str, string_->value_, string_->size_, CYStringifyModeLegacy, CYStringTypeTemplate, false);
+
+    CYForEach (span, spans_) {
+        str << "${";
+        out << str.str().c_str();
+        span->expression_->Output(out, CYNoFlags);
+
+        str.str(std::string());
+        str << '}';
+        CYStringifyBody(str, span->string_->value_, span->string_->size_, CYStringifyModeLegacy, CYStringTypeTemplate, false);
+    }
+
+    str << '`';
+    out << str.str().c_str();
 }
 
 void CYTypeArrayOf::Output(CYOutput &out, CYPropertyName *name) const {
@@ -861,7 +911,7 @@ void CYTypeExpression::Output(CYOutput &out, CYFlags flags) const {
 }
 
 void CYLexical::Output(CYOutput &out, CYFlags flags) const {
-    out << "let" << ' ';
+    out << (constant_ ? "const" : "let") << ' ';
     bindings_->Output(out, flags); // XXX: flags
     out << ';';
 }
@@ -939,31 +989,47 @@ void CYProperty::Output(CYOutput &out) const {
     out << '\n' <<  next_;
 }
 
-void CYPropertyGetter::Output(CYOutput &out) const {
+void CYPropertyGetter::Define(CYOutput &out) const {
     out << "get" << ' ';
     name_->PropertyName(out);
     CYFunction::Output(out);
+}
+
+void CYPropertyGetter::Output(CYOutput &out) const {
+    Define(out);
     CYProperty::Output(out);
 }
 
-void CYPropertyMethod::Output(CYOutput &out) const {
+void CYPropertyMethod::Define(CYOutput &out) const {
     name_->PropertyName(out);
     CYFunction::Output(out);
+}
+
+void CYPropertyMethod::Output(CYOutput &out) const {
+    Define(out);
     CYProperty::Output(out);
 }
 
-void CYPropertySetter::Output(CYOutput &out) const {
+void CYPropertySetter::Define(CYOutput &out) const {
     out << "set" << ' ';
     name_->PropertyName(out);
     CYFunction::Output(out);
+}
+
+void CYPropertySetter::Output(CYOutput &out) const {
+    Define(out);
     CYProperty::Output(out);
 }
 
-void CYPropertyValue::Output(CYOutput &out) const {
-    out << '\t';
+void CYPropertyValue::Define(CYOutput &out) const {
     name_->PropertyName(out);
     out << ':' << ' ';
     value_->Output(out, CYAssign::Precedence_, CYNoFlags);
+}
+
+void CYPropertyValue::Output(CYOutput &out) const {
+    out << '\t';
+    Define(out);
     CYProperty::Output(out);
 }
 
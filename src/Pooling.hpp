@@ -28,6 +28,7 @@
 #include <cstring>
 
 #include <algorithm>
+#include <type_traits>
 
 #ifdef _MSC_VER
 #include <malloc.h>
@@ -50,11 +51,100 @@ class CYPool;
 _finline void *operator new(size_t size, CYPool &pool);
 _finline void *operator new [](size_t size, CYPool &pool);
 
+struct CYPoolStatistics {
+    size_t requested_;
+    size_t wasted_;
+    size_t blocks_;
+    size_t recycled_;
+    size_t cleaners_;
+
+    CYPoolStatistics &operator +=(const CYPoolStatistics &rhs) {
+        requested_ += rhs.requested_;
+        wasted_ += rhs.wasted_;
+        blocks_ += rhs.blocks_;
+        recycled_ += rhs.recycled_;
+        cleaners_ += rhs.cleaners_;
+        return *this;
+    }
+};
+
+// blocks grow by doubling up to this size; larger ones are only made for single large requests
+static const size_t CYPoolBlockLimit(1 << 20);
+// each thread keeps at most this many bytes of released blocks for reuse by its next pools
+static const size_t CYPoolCacheLimit(4 << 20);
+
+struct CYPoolBlock {
+    CYPoolBlock *next_;
+    size_t size_;
+};
+
+// the blocks a thread's pools released, kept for its next pools and freed when the thread exits
+struct CYPoolCache {
+    CYPoolBlock *free_[32];
+    size_t size_;
+    CYPoolStatistics totals_;
+
+    CYPoolCache() :
+        free_(),
+        size_(0),
+        totals_()
+    {
+    }
+
+    ~CYPoolCache() {
+        for (size_t i(0); i != sizeof(free_) / sizeof(free_[0]); ++i)
+            for (CYPoolBlock *block(free_[i]); block != NULL; ) {
+                CYPoolBlock *next(block->next_);
+                ::free(block);
+                block = next;
+            }
+    }
+};
+
+template <>
+struct CYLocalExit<CYPoolCache> {
+    static void Exit(CYPoolCache *cache) {
+        delete cache;
+    }
+};
+
 class CYPool {
+  public:
+    typedef CYPoolBlock Block;
+
   private:
+    typedef CYPoolCache Cache;
+
+    // a pool destroyed after its thread's cache was freed makes a new one, which the thread's exit frees again
+    struct Local_ :
+        CYLocal<Cache>
+    {
+        static Cache &Get_() {
+            Cache *cache(Get());
+            if (cache == NULL) {
+                cache = new Cache();
+                Set(cache);
+            }
+            return *cache;
+        }
+    };
+
+    static Cache &Local() {
+        return Local_::Get_();
+    }
+
+    static size_t Class(size_t size) {
+        size_t index(0);
+        while ((size_t(1) << index) < size)
+            ++index;
+        return index;
+    }
+
     uint8_t *data_;
     size_t size_;
     size_t next_;
+    Block *blocks_;
+    CYPoolStatistics statistics_;
 
     struct Cleaner {
         Cleaner *next_;
@@ -74,6 +164,42 @@ class CYPool {
         reinterpret_cast<Type_ *>(data)->~Type_();
     }
 
+    Block *Acquire(size_t size) {
+        ++statistics_.blocks_;
+
+        if (size <= CYPoolBlockLimit) {
+            size_t index(Class(size));
+            size = size_t(1) << index;
+
+            Cache &cache(Local());
+            if (Block *block = cache.free_[index]) {
+                cache.free_[index] = block->next_;
+                cache.size_ -= size;
+                ++statistics_.recycled_;
+                return block;
+            }
+        }
+
+        Block *block(reinterpret_cast<Block *>(::malloc(size)));
+        _assert(block != NULL);
+        block->size_ = size;
+        return block;
+    }
+
+    static void Release(Block *block) {
+        Cache &cache(Local());
+        size_t size(block->size_);
+
+        if (size > CYPoolBlockLimit || cache.size_ + size > CYPoolCacheLimit)
+            ::free(block);
+        else {
+            size_t index(Class(size));
+            block->next_ = cache.free_[index];
+            cache.free_[index] = block;
+            cache.size_ += size;
+        }
+    }
+
     CYPool(const CYPool &);
 
   public:
@@ -81,6 +207,8 @@ class CYPool {
         data_(NULL),
         size_(0),
         next_(next),
+        blocks_(NULL),
+        statistics_(),
         cleaner_(NULL)
     {
     }
@@ -91,6 +219,15 @@ class CYPool {
             (*cleaner->code_)(cleaner->data_);
             cleaner = next;
         }
+
+        statistics_.wasted_ += size_;
+        Local().totals_ += statistics_;
+
+        for (Block *block(blocks_); block != NULL; ) {
+            Block *next(block->next_);
+            Release(block);
+            block = next;
+        }
     }
 
     template <typename Type_>
@@ -100,24 +237,66 @@ class CYPool {
         end += size;
 
         if (size_t(end - data_) > size_) {
-            size_t need(sizeof(Cleaner));
+            size_t need(sizeof(Block));
             CYAlign(need, alignment);
             need += size;
-            size_ = std::max<size_t>(next_, need);
-            next_ *= 2;
-            data_ = reinterpret_cast<uint8_t *>(::malloc(size_));
-            atexit(free, data_);
+
+            Block *block(Acquire(std::max<size_t>(next_, need)));
+            block->next_ = blocks_;
+            blocks_ = block;
+
+            if (next_ < CYPoolBlockLimit)
+                next_ *= 2;
+
+            statistics_.wasted_ += size_;
+            data_ = reinterpret_cast<uint8_t *>(block + 1);
+            size_ = block->size_ - sizeof(Block);
             _assert(size <= size_);
         }
 
         uint8_t *data(data_);
         CYAlign(data, alignment);
         end = data + size;
+        statistics_.requested_ += size;
+        statistics_.wasted_ += data - data_;
         size_ -= end - data_;
         data_ = end;
         return reinterpret_cast<Type_ *>(data);
     }
 
+    // grows the most recent allocation in place, if the current block has room for it
+    bool Extend(void *data, size_t size, size_t more) {
+        if (static_cast<uint8_t *>(data) + size != data_ || more > size_)
+            return false;
+        data_ += more;
+        size_ -= more;
+        statistics_.requested_ += more;
+        return true;
+    }
+
+    // gives the unused tail of the most recent allocation back to the current block
+    void Trim(void *data, size_t size, size_t used) {
+        if (static_cast<uint8_t *>(data) + size != data_)
+            return;
+        size_t unused(size - used);
+        data_ -= unused;
+        size_ += unused;
+        statistics_.requested_ -= unused;
+    }
+
+    size_t Allocated() const {
+        return statistics_.requested_;
+    }
+
+    const CYPoolStatistics &Statistics() const {
+        return statistics_;
+    }
+
+    // totals of every pool destroyed so far on the calling thread
+    static const CYPoolStatistics &Totals() {
+        return Local().totals_;
+    }
+
     template <typename Type_>
     Type_ *calloc(size_t count, size_t size, size_t alignment = CYAlignment) {
         Type_ *data(malloc<Type_>(count * size, alignment));
@@ -231,6 +410,7 @@ _finline void *operator new [](size_t size, CYPool &pool) {
 
 _finline void CYPool::atexit(void (*code)(void *), void *data) {
     cleaner_ = new(*this) Cleaner(cleaner_, code, data);
+    ++statistics_.cleaners_;
 }
 
 struct CYData {
@@ -321,6 +501,87 @@ struct CYPoolAllocator {
     };
 };
 
+class CYBuffer {
+  private:
+    CYPool &pool_;
+    char *data_;
+    size_t size_;
+    size_t capacity_;
+
+    void Reserve(size_t more) {
+        // leave room for the terminator added by Finish
+        size_t need(size_ + more + 1);
+        if (need <= capacity_)
+            return;
+
+        size_t capacity(std::max(capacity_ * 2, need));
+        if (!pool_.Extend(data_, capacity_, capacity - capacity_)) {
+            char *data(pool_.malloc<char>(capacity, 1));
+            memcpy(data, data_, size_);
+            data_ = data;
+        }
+
+        capacity_ = capacity;
+    }
+
+    CYBuffer(const CYBuffer &);
+
+  public:
+    CYBuffer(CYPool &pool, size_t capacity = 32) :
+        pool_(pool),
+        data_(pool.malloc<char>(capacity, 1)),
+        size_(0),
+        capacity_(capacity)
+    {
+    }
+
+    CYBuffer &Write(const char *data, size_t size) {
+        Reserve(size);
+        memcpy(data_ + size_, data, size);
+        size_ += size;
+        return *this;
+    }
+
+    CYBuffer &operator <<(char value) {
+        Reserve(1);
+        data_[size_++] = value;
+        return *this;
+    }
+
+    CYBuffer &operator <<(const char *value) {
+        return Write(value, strlen(value));
+    }
+
+    template <typename Type_>
+    typename std::enable_if<std::is_integral<Type_>::value, CYBuffer &>::type operator <<(Type_ value) {
+        char digits[sizeof(Type_) * 3 + 1];
+        char *end(digits + sizeof(digits)), *begin(end);
+
+        bool negative(value < 0);
+        do {
+            Type_ digit(value % 10);
+            *--begin = '0' + (negative ? -digit : digit);
+            value /= 10;
+        } while (value != 0);
+
+        if (negative)
+            *--begin = '-';
+        return Write(begin, end - begin);
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    // terminates the string and returns the capacity it did not use to the pool
+    char *Finish() {
+        data_[size_] = '\0';
+        pool_.Trim(data_, capacity_, size_ + 1);
+        capacity_ = size_ + 1;
+        return data_;
+    }
+};
+
 class CYLocalPool :
     public CYPool
 {
@@ -19,12 +19,17 @@
 **/
 /* }}} */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iomanip>
 #include <map>
 
 #include "Replace.hpp"
 #include "Syntax.hpp"
 
+#include "sig/parse.hpp"
+
 CYFunctionExpression *CYNonLocalize(CYContext &context, CYFunctionExpression *function) {
     function->nonlocal_ = context.nextlocal_;
     return function;
@@ -47,6 +52,110 @@ static void CYImplicitReturn(CYStatement *&code) {
         last = last->Return();
 }
 
+// a folded result is only emitted when it reads back as the same number: NaN stays unfolded and negatives keep their unary minus
+static CYExpression *CYReplaceNumber(CYContext &context, double value) {
+    if (std::isnan(value))
+        return NULL;
+    if (std::signbit(value))
+        return $ CYNegate($D(-value));
+    return $D(value);
+}
+
+static uint32_t CYReplaceUInt32(double value) {
+    if (!std::isfinite(value))
+        return 0;
+    return uint32_t(int64_t(std::fmod(std::trunc(value), 4294967296.0)));
+}
+
+static int32_t CYReplaceInt32(double value) {
+    return int32_t(CYReplaceUInt32(value));
+}
+
+static CYExpression *CYReplaceBoolean(CYContext &context, bool value) {
+    if (value)
+        return $ CYTrue();
+    return $ CYFalse();
+}
+
+// the typeof of a primitive literal, or NULL if the value is not one
+static const char *CYReplaceType(CYExpression *value) {
+    if (dynamic_cast<CYString *>(value) != NULL)
+        return "string";
+    if (dynamic_cast<CYNumber *>(value) != NULL)
+        return "number";
+    if (CYNegate *negate = dynamic_cast<CYNegate *>(value))
+        if (dynamic_cast<CYNumber *>(negate->rhs_) != NULL)
+            return "number";
+    if (dynamic_cast<CYBoolean *>(value) != NULL)
+        return "boolean";
+    if (dynamic_cast<CYNull *>(value) != NULL)
+        return "object";
+    return NULL;
+}
+
+// 1 or 0 for a primitive literal that is truthy or falsy, -1 if it is not known
+static int CYReplaceTruth(CYContext &context, CYExpression *value) {
+    const char *type(CYReplaceType(value));
+    if (type == NULL)
+        return -1;
+    if (CYString *string = dynamic_cast<CYString *>(value))
+        return string->size_ != 0;
+    double number(value->Number(context)->Value());
+    return number != 0 && !std::isnan(number);
+}
+
+// 1 or 0 for literals that are (loosely) equal or not, -1 if it is not known
+static int CYReplaceEqual(CYContext &context, CYExpression *lhs, CYExpression *rhs, bool strict) {
+    const char *lht(CYReplaceType(lhs));
+    const char *rht(CYReplaceType(rhs));
+    if (lht == NULL || rht == NULL)
+        return -1;
+
+    if (strcmp(lht, rht) != 0) {
+        if (strict || strcmp(lht, "object") == 0 || strcmp(rht, "object") == 0)
+            return 0;
+        if (strcmp(lht, "string") == 0 || strcmp(rht, "string") == 0)
+            return -1;
+    } else if (strcmp(lht, "string") == 0) {
+        CYString *left(static_cast<CYString *>(lhs));
+        CYString *right(static_cast<CYString *>(rhs));
+        return left->size_ == right->size_ && memcmp(left->value_, right->value_, left->size_) == 0;
+    }
+
+    return lhs->Number(context)->Value() == rhs->Number(context)->Value();
+}
+
+// a const initialized to a primitive literal is read as that literal by the uses after it
+static void CYReplaceConstant(CYContext &context, CYBinding *binding) {
+    CYTrivial *value(dynamic_cast<CYTrivial *>(binding->initializer_));
+    if (value != NULL && CYReplaceType(value) != NULL)
+        context.scope_->Lookup(context, binding->identifier_)->constant_ = value;
+}
+
+// only uses in the same function see the const, and a with or an eval (which damage their scopes) might rebind it
+static CYTrivial *CYReplaceConstant(CYContext &context, CYIdentifier *name) {
+    for (CYScope *scope(context.scope_); scope != NULL; scope = scope->parent_) {
+        if (scope->transparent_ && scope->damaged_)
+            break;
+        if (CYIdentifierFlags *flags = scope->Lookup(context, name))
+            if (flags->kind_ != CYIdentifierGlobal && flags->kind_ != CYIdentifierMagic)
+                return flags->constant_;
+        if (!scope->transparent_)
+            break;
+    }
+
+    return NULL;
+}
+
+// a const is only substituted where it is read: written to, it stays a name, so that fails at run time rather than parse time
+template <typename Type_>
+static void CYReplaceWritten(CYContext &context, Type_ *&target) {
+    if (CYVariable *variable = dynamic_cast<CYVariable *>(target))
+        variable->name_ = variable->name_->Replace(context, CYIdentifierGlobal);
+    else
+        context.Replace(target);
+}
+
 CYExpression *CYAdd::Replace(CYContext &context) {
     CYInfix::Replace(context);
 
@@ -69,7 +178,8 @@ CYExpression *CYAdd::Replace(CYContext &context) {
 
     if (CYNumber *lhn = lhs_->Number(context))
         if (CYNumber *rhn = rhs_->Number(context))
-            return $D(lhn->Value() + rhn->Value());
+            if (CYExpression *value = CYReplaceNumber(context, lhn->Value() + rhn->Value()))
+                return value;
 
     return this;
 }
@@ -78,6 +188,16 @@ CYExpression *CYAddressOf::Replace(CYContext &context) {
     return $C0($M(rhs_, $S("$cya")));
 }
 
+CYExpression *CYAffirm::Replace(CYContext &context) {
+    CYPrefix::Replace(context);
+
+    if (CYNumber *number = rhs_->Number(context))
+        if (CYExpression *value = CYReplaceNumber(context, number->Value()))
+            return value;
+
+    return this;
+}
+
 CYTarget *CYApply::AddArgument(CYContext &context, CYExpression *value) {
     CYArgument **argument(&arguments_);
     while (*argument != NULL)
@@ -116,21 +236,126 @@ CYTarget *CYArrayComprehension::Replace(CYContext &context) {
     ));
 }
 
+// spills value into a fresh variable so it is evaluated once but can be named from both arms of a condition
+static CYIdentifier *CYReplaceTemporary(CYContext &context, CYExpression *&sequence, CYExpression *value) {
+    CYIdentifier *unique(context.Unique());
+    context.scope_->Declare(context, unique, CYIdentifierVariable);
+    CYExpression *assign($ CYAssign($V(unique), value));
+    sequence = sequence == NULL ? assign : $ CYCompound(sequence, assign);
+    return unique;
+}
+
+static CYExpression *CYReplaceOperand(CYContext &context, CYExpression *&sequence, CYExpression *value) {
+    if (dynamic_cast<CYTrivial *>(value) != NULL)
+        return value;
+    return $V(CYReplaceTemporary(context, sequence, value));
+}
+
+static CYExpression *CYReference(CYExpression *value) {
+    if (CYVariable *variable = dynamic_cast<CYVariable *>(value))
+        return $V(variable->name_);
+    return value;
+}
+
+// object.[key] only calls $cyg/$cys when the object has them (NSArray, NSDictionary, java.lang.Object); everything
+// else is indexed natively behind a property check, which is much cheaper than the call in a loop
+static CYExpression *CYReplaceSubscript(CYContext &context, CYSubscriptMember *subscript, CYAssignment *assignment) {
+    CYExpression *object(subscript->object_);
+
+    if (dynamic_cast<CYArray *>(object) != NULL) {
+        CYTarget *member($M(object, subscript->property_));
+        if (assignment == NULL)
+            return member;
+        // the assignment is returned as itself, which ends the replacement loop, so its parts are replaced here
+        context.Replace(member);
+        context.Replace(assignment->rhs_);
+        assignment->lhs_ = member;
+        return assignment;
+    }
+
+    CYExpression *sequence(NULL);
+    CYIdentifier *self(CYReplaceTemporary(context, sequence, object));
+    CYExpression *key(CYReplaceOperand(context, sequence, subscript->property_));
+
+    CYExpression *native, *fallback;
+    if (assignment == NULL) {
+        native = $M($V(self), key);
+        fallback = $C1($M($V(self), $S("$cyg")), CYReference(key));
+    } else {
+        CYExpression *value(CYReplaceOperand(context, sequence, assignment->rhs_));
+        // object.[key] OP= value becomes $cys(key, $cyg(key) OP value)
+        CYExpression *stored(assignment->Combine($C1($M($V(self), $S("$cyg")), CYReference(key)), CYReference(value)));
+        fallback = $C2($M($V(self), $S("$cys")), CYReference(key), stored);
+        assignment->lhs_ = $M($V(self), key);
+        assignment->rhs_ = value;
+        native = assignment;
+    }
+
+    return $ CYCompound(sequence, $ CYCondition($ CYEqual($M($V(self), $S(assignment == NULL ? "$cyg" : "$cys")), $ CYNull()), native, fallback));
+}
+
 CYExpression *CYAssignment::Replace(CYContext &context) {
-    // XXX: this is a horrible hack but I'm a month over schedule :(
     if (CYSubscriptMember *subscript = dynamic_cast<CYSubscriptMember *>(lhs_))
-        return $C2($M(subscript->object_, $S("$cys")), subscript->property_, rhs_);
-    context.Replace(lhs_);
+        return CYReplaceSubscript(context, subscript, this);
+    CYReplaceWritten(context, lhs_);
     context.Replace(rhs_);
     return this;
 }
 
+// object?.property and object?.method() evaluate object once into a temporary rather than through a closure
+static CYTarget *CYReplaceAttempt(CYContext &context, CYAttemptMember *member, CYArgument *arguments, bool call) {
+    CYExpression *sequence(NULL);
+    CYIdentifier *value(CYReplaceTemporary(context, sequence, member->object_));
+    CYTarget *target($M($V(value), member->property_));
+    if (call)
+        target = $C(target, arguments);
+    return $ CYParenthetical($ CYCompound(sequence, $ CYCondition($V(value), target, $V(value))));
+}
+
 CYTarget *CYAttemptMember::Replace(CYContext &context) {
-    CYIdentifier *value(context.Unique());
+    return CYReplaceAttempt(context, this, NULL, false);
+}
+
+CYExpression *CYBitwiseAnd::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            if (CYExpression *value = CYReplaceNumber(context, CYReplaceInt32(lhn->Value()) & CYReplaceInt32(rhn->Value())))
+                return value;
+
+    return this;
+}
 
-    return $C1($F(NULL, $P1($B(value)), $$
-        ->* $ CYReturn($ CYCondition($V(value), $M($V(value), property_), $V(value)))
-    ), object_);
+CYExpression *CYBitwiseNot::Replace(CYContext &context) {
+    CYPrefix::Replace(context);
+
+    if (CYNumber *number = rhs_->Number(context))
+        return CYReplaceNumber(context, ~CYReplaceInt32(number->Value()));
+
+    return this;
+}
+
+CYExpression *CYBitwiseOr::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            if (CYExpression *value = CYReplaceNumber(context, CYReplaceInt32(lhn->Value()) | CYReplaceInt32(rhn->Value())))
+                return value;
+
+    return this;
+}
+
+CYExpression *CYBitwiseXOr::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            if (CYExpression *value = CYReplaceNumber(context, CYReplaceInt32(lhn->Value()) ^ CYReplaceInt32(rhn->Value())))
+                return value;
+
+    return this;
 }
 
 CYStatement *CYBlock::Return() {
@@ -153,14 +378,8 @@ CYStatement *CYBreak::Replace(CYContext &context) {
 }
 
 CYTarget *CYCall::Replace(CYContext &context) {
-    // XXX: this also is a horrible hack but I'm still a month over schedule :(
-    if (CYAttemptMember *member = dynamic_cast<CYAttemptMember *>(function_)) {
-        CYIdentifier *value(context.Unique());
-
-        return $C1($F(NULL, $P1($B(value)), $$
-            ->* $ CYReturn($ CYCondition($V(value), $C($M($V(value), member->property_), arguments_), $V(value)))
-        ), member->object_);
-    }
+    if (CYAttemptMember *member = dynamic_cast<CYAttemptMember *>(function_))
+        return CYReplaceAttempt(context, member, arguments_, true);
 
     context.Replace(function_);
     arguments_->Replace(context);
@@ -181,7 +400,39 @@ void Catch::Replace(CYContext &context) { $T()
 
 } }
 
+static void CYReplaceKeys(CYContext &context, CYProperty *members) {
+    CYForEach (member, members)
+        if (CYComputed *computed = dynamic_cast<CYComputed *>(member->name_))
+            context.Replace(computed->expression_);
+}
+
+void CYClassTail::Outer(CYContext &context) {
+    context.Replace(extends_);
+    CYReplaceKeys(context, static_);
+    CYReplaceKeys(context, instance_);
+}
+
+void CYClassTail::Replace(CYContext &context) {
+    if (constructor_ != NULL)
+        constructor_->Replace(context);
+
+    CYForEach (member, static_)
+        member->Replace(context);
+    CYForEach (member, instance_)
+        member->Replace(context);
+}
+
 CYTarget *CYClassExpression::Replace(CYContext &context) {
+    if (context.options_.standard_ >= CYStandardES2015) {
+        tail_->Outer(context);
+        CYScope scope(false, context);
+        if (name_ != NULL)
+            name_ = name_->Replace(context, CYIdentifierOther);
+        tail_->Replace(context);
+        scope.Close(context);
+        return this;
+    }
+
     CYBuilder builder;
 
     CYIdentifier *super(context.Unique());
@@ -218,6 +469,13 @@ CYTarget *CYClassExpression::Replace(CYContext &context) {
 }
 
 CYStatement *CYClassStatement::Replace(CYContext &context) {
+    if (context.options_.standard_ >= CYStandardES2015) {
+        name_ = name_->Replace(context, CYIdentifierLexical);
+        tail_->Outer(context);
+        tail_->Replace(context);
+        return this;
+    }
+
     return $ CYVar($B1($B(name_, $ CYClassExpression(name_, tail_))));
 }
 
@@ -275,6 +533,12 @@ CYExpression *CYCondition::Replace(CYContext &context) {
     context.Replace(test_);
     context.Replace(true_);
     context.Replace(false_);
+
+    switch (CYReplaceTruth(context, test_)) {
+        case 0: return false_;
+        case 1: return true_;
+    }
+
     return this;
 }
 
@@ -303,8 +567,62 @@ void CYContext::NonLocal(CYStatement *&statements) {
     }
 }
 
+// a statement that declares a name in its block (a var is hoisted, but its statement stays with the others)
+static bool CYReplaceDeclares(CYStatement *statement) {
+    return
+        dynamic_cast<CYFunctionStatement *>(statement) != NULL ||
+        dynamic_cast<CYClassStatement *>(statement) != NULL ||
+        dynamic_cast<CYLexical *>(statement) != NULL ||
+        dynamic_cast<CYVar *>(statement) != NULL;
+}
+
+// statements after a return, throw, break or continue never run, though the declarations among them are hoisted and stay
+void CYContext::Prune(CYStatement *&statements) {
+    bool reachable(true);
+
+    for (CYStatement **last(&statements); *last != NULL; ) {
+        CYStatement *statement(*last);
+
+        bool dead;
+        if (!reachable)
+            dead = !CYReplaceDeclares(statement);
+        else if (dynamic_cast<CYEmpty *>(statement) != NULL)
+            dead = true;
+        else if (CYExpress *express = dynamic_cast<CYExpress *>(statement))
+            // a string might be a directive, and the last statement might be the completion value or an implicit return
+            dead = statement->next_ != NULL && CYReplaceType(express->expression_) != NULL && dynamic_cast<CYString *>(express->expression_) == NULL;
+        else if (CYBlock *block = dynamic_cast<CYBlock *>(statement)) {
+            // a block of one statement that declares nothing does not need its braces
+            CYStatement *code(block->code_);
+            if (code != NULL && code->next_ == NULL && !CYReplaceDeclares(code)) {
+                code->SetNext(statement->next_);
+                *last = code;
+                continue;
+            }
+
+            dead = false;
+        } else {
+            dead = false;
+            if (
+                dynamic_cast<CYReturn *>(statement) != NULL ||
+                dynamic_cast<cy::Syntax::Throw *>(statement) != NULL ||
+                dynamic_cast<CYBreak *>(statement) != NULL ||
+                dynamic_cast<CYContinue *>(statement) != NULL
+            )
+                reachable = false;
+        }
+
+        if (dead)
+            *last = statement->next_;
+        else
+            last = &statement->next_;
+    }
+}
+
 CYIdentifier *CYContext::Unique() {
-    return $ CYIdentifier($pool.strcat("$cy", $pool.itoa(unique_++), NULL));
+    CYBuffer name($pool, 8);
+    name << "$cy" << unique_++;
+    return $ CYIdentifier(name.Finish());
 }
 
 CYStatement *CYContinue::Replace(CYContext &context) {
@@ -350,12 +668,28 @@ CYArgument *CYBindings::Argument(CYContext &context) { $T(NULL)
     return $ CYArgument(binding_->initializer_, next_->Argument(context));
 }
 
+CYExpression *CYDelete::Replace(CYContext &context) {
+    CYReplaceWritten(context, rhs_);
+    return this;
+}
+
 CYTarget *CYDirectMember::Replace(CYContext &context) {
     context.Replace(object_);
     context.Replace(property_);
     return this;
 }
 
+CYExpression *CYDivide::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            if (CYExpression *value = CYReplaceNumber(context, lhn->Value() / rhn->Value()))
+                return value;
+
+    return this;
+}
+
 CYStatement *CYDoWhile::Replace(CYContext &context) {
     context.Replace(test_);
     context.ReplaceAll(code_);
@@ -378,6 +712,15 @@ CYTarget *CYEncodedType::Replace(CYContext &context) {
     return typed_->Replace(context);
 }
 
+CYExpression *CYEqual::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    int equal(CYReplaceEqual(context, lhs_, rhs_, false));
+    if (equal == -1)
+        return this;
+    return CYReplaceBoolean(context, equal);
+}
+
 CYTarget *CYEval::Replace(CYContext &context) {
     context.scope_->Damage();
     if (arguments_ != NULL)
@@ -394,6 +737,74 @@ CYForInitializer *CYExpress::Replace(CYContext &context) {
     return this;
 }
 
+// these are matched by name alone, so this relies on the receiver having Array semantics: the callback is called synchronously, before the method returns, and never afterwards
+static const struct {
+    const char *name_;
+    CYEscapeStop stop_;
+} CYIterators_[] = {
+    {"every", CYEscapeFalse},
+    {"filter", CYEscapeNever},
+    {"find", CYEscapeTrue},
+    {"findIndex", CYEscapeTrue},
+    {"forEach", CYEscapeNever},
+    {"map", CYEscapeNever},
+    {"some", CYEscapeTrue},
+};
+
+static const CYEscapeStop *CYIterates(const char *name) {
+    for (size_t i(0); i != sizeof(CYIterators_) / sizeof(CYIterators_[0]); ++i)
+        if (strcmp(name, CYIterators_[i].name_) == 0)
+            return &CYIterators_[i].stop_;
+    return NULL;
+}
+
+CYExpression *CYEscape::Stop() const {
+    switch (stop_) {
+        case CYEscapeTrue:
+            return $ CYTrue();
+        case CYEscapeFalse:
+            return $ CYFalse();
+        default:
+            return NULL;
+    }
+}
+
+CYStatement *CYExpress::Expand(CYContext &context) {
+    // object.forEach { ... return value; } sets a flag from the block and returns after the call, instead of throwing
+    CYRubyBlock *block(dynamic_cast<CYRubyBlock *>(expression_));
+    if (block == NULL)
+        return this;
+    CYDirectMember *member(dynamic_cast<CYDirectMember *>(block->lhs_));
+    if (member == NULL)
+        return this;
+    CYString *name(dynamic_cast<CYString *>(member->property_));
+    if (name == NULL)
+        return this;
+    const CYEscapeStop *stop(CYIterates(name->Value()));
+    if (stop == NULL)
+        return this;
+
+    CYFunctionExpression *function(dynamic_cast<CYFunctionExpression *>(block->proc_->Replace(context)));
+    _assert(function != NULL);
+    CYEscape *escape($ CYEscape(context, *stop));
+    function->escape_ = escape;
+
+    CYExpression *call(member->AddArgument(context, function));
+    context.Replace(call);
+    if (!escape->used_)
+        return $E(call);
+
+    context.scope_->Declare(context, escape->flag_, CYIdentifierVariable);
+    context.scope_->Declare(context, escape->value_, CYIdentifierVariable);
+
+    CYStatement *check($ CYIf($V(escape->flag_), $ CYReturn($ CYCompound($ CYAssign($V(escape->flag_), $ CYFalse()), $V(escape->value_)))));
+    context.Replace(check);
+
+    return $ CYBlock($$
+        ->* $E(call)
+        ->* check);
+}
+
 CYTarget *CYExpression::AddArgument(CYContext &context, CYExpression *value) {
     return $C1(this, value);
 }
@@ -426,6 +837,13 @@ CYString *CYFalse::String(CYContext &context) {
 }
 
 CYExpression *CYFatArrow::Replace(CYContext &context) {
+    if (context.options_.standard_ >= CYStandardES2015) {
+        CYScope scope(false, context);
+        CYFunction::Replace(context);
+        scope.Close(context);
+        return this;
+    }
+
     CYFunctionExpression *function($ CYFunctionExpression(NULL, parameters_, code_));
     function->this_.SetNext(context.this_);
     return function;
@@ -470,9 +888,20 @@ CYTarget *CYForLexical::Replace(CYContext &context) {
     return binding_->Target(context);
 }
 
+// from ES2015 on, a let or const loop binding is declared in place rather than turned into a hoisted var
+static void CYReplaceLoop(CYContext &context, CYForInInitializer *&initializer) {
+    if (context.options_.standard_ >= CYStandardES2015)
+        if (CYForLexical *lexical = dynamic_cast<CYForLexical *>(initializer)) {
+            _assert(lexical->binding_->Replace(context, CYIdentifierLexical) == NULL);
+            return;
+        }
+
+    CYReplaceWritten(context, initializer);
+}
+
 CYStatement *CYForIn::Replace(CYContext &context) {
     CYScope scope(true, context);
-    context.Replace(initializer_);
+    CYReplaceLoop(context, initializer_);
     context.Replace(iterable_);
     context.ReplaceAll(code_);
     scope.Close(context);
@@ -495,6 +924,15 @@ CYStatement *CYForInComprehension::Replace(CYContext &context, CYStatement *stat
 }
 
 CYStatement *CYForOf::Replace(CYContext &context) {
+    if (context.options_.standard_ >= CYStandardES2015) {
+        CYScope scope(true, context);
+        CYReplaceLoop(context, initializer_);
+        context.Replace(iterable_);
+        context.ReplaceAll(code_);
+        scope.Close(context);
+        return this;
+    }
+
     CYIdentifier *item(context.Unique()), *list(context.Unique());
 
     return $ CYBlock($$
@@ -551,6 +989,9 @@ void CYFunction::Replace(CYContext &context) {
     CYNonLocal *nonlocal(context.nonlocal_);
     CYNonLocal *nextlocal(context.nextlocal_);
 
+    CYEscape *escape(context.escape_);
+    context.escape_ = escape_;
+
     bool localize;
     if (nonlocal_ != NULL) {
         localize = false;
@@ -572,6 +1013,16 @@ void CYFunction::Replace(CYContext &context) {
     if (implicit_)
         CYImplicitReturn(code_);
 
+    if (escape_ != NULL && escape_->used_) {
+        // a helper that can't be stopped keeps calling the block after it has returned, so those calls must do nothing
+        CYStatement *guard($ CYIf($V(escape_->flag_), $ CYReturn(escape_->Stop())));
+        context.escape_ = NULL;
+        context.nonlocal_ = NULL;
+        context.Replace(guard);
+        guard->SetNext(code_);
+        code_ = guard;
+    }
+
     if (CYIdentifier *identifier = this_.identifier_) {
         context.scope_->Declare(context, identifier, CYIdentifierVariable);
         code_ = $$
@@ -584,6 +1035,7 @@ void CYFunction::Replace(CYContext &context) {
 
     context.nextlocal_ = nextlocal;
     context.nonlocal_ = nonlocal;
+    context.escape_ = escape;
 
     context.super_ = super;
     context.this_ = _this;
@@ -619,6 +1071,35 @@ CYStatement *CYFunctionStatement::Replace(CYContext &context) {
     return this;
 }
 
+CYExpression *CYGreater::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            return CYReplaceBoolean(context, lhn->Value() > rhn->Value());
+
+    return this;
+}
+
+CYExpression *CYGreaterOrEqual::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            return CYReplaceBoolean(context, lhn->Value() >= rhn->Value());
+
+    return this;
+}
+
+CYExpression *CYIdentical::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    int equal(CYReplaceEqual(context, lhs_, rhs_, true));
+    if (equal == -1)
+        return this;
+    return CYReplaceBoolean(context, equal);
+}
+
 CYIdentifier *CYIdentifier::Replace(CYContext &context, CYIdentifierKind kind) {
     if (next_ == this)
         return this;
@@ -634,8 +1115,24 @@ CYStatement *CYIf::Return() {
     return this;
 }
 
+static CYStatement *CYReplaceBranch(CYContext &context, CYStatement *branch) {
+    if (branch == NULL)
+        return $ CYEmpty();
+    if (branch->next_ != NULL)
+        return $ CYBlock(branch);
+    return branch;
+}
+
 CYStatement *CYIf::Replace(CYContext &context) {
     context.Replace(test_);
+
+    // the branch not taken is still replaced, as the variables it declares are hoisted
+    if (context.options_.minify_)
+        switch (CYReplaceTruth(context, test_)) {
+            case 0: context.ReplaceAll(true_); return CYReplaceBranch(context, false_);
+            case 1: context.ReplaceAll(false_); return CYReplaceBranch(context, true_);
+        }
+
     context.ReplaceAll(true_);
     context.ReplaceAll(false_);
     return this;
@@ -697,12 +1194,97 @@ CYTarget *CYLambda::Replace(CYContext &context) {
     return $N2($V("Functor"), $ CYFunctionExpression(NULL, parameters_->Parameters(context), code_), parameters_->TypeSignature(context, typed_->Replace(context)));
 }
 
+CYExpression *CYLess::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            return CYReplaceBoolean(context, lhn->Value() < rhn->Value());
+
+    return this;
+}
+
+CYExpression *CYLessOrEqual::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            return CYReplaceBoolean(context, lhn->Value() <= rhn->Value());
+
+    return this;
+}
+
 CYForInitializer *CYLexical::Replace(CYContext &context) {
+    if (context.options_.standard_ >= CYStandardES2015) {
+        CYForEach (bindings, bindings_) {
+            CYBinding *binding(bindings->binding_);
+            binding->identifier_ = binding->identifier_->Replace(context, CYIdentifierLexical);
+            context.Replace(binding->initializer_);
+            if (constant_)
+                CYReplaceConstant(context, binding);
+        }
+
+        return this;
+    }
+
     if (CYExpression *expression = bindings_->Replace(context, CYIdentifierLexical))
         return $E(expression);
     return $ CYEmpty();
 }
 
+CYStatement *CYLexical::Expand(CYContext &context) {
+    // the assignments a const lowers to are built already replaced, as their targets would otherwise read back as the constant
+    if (!constant_ || context.options_.standard_ >= CYStandardES2015)
+        return this;
+
+    CYExpression *expression(NULL);
+    CYForEach (bindings, bindings_) {
+        CYBinding *binding(bindings->binding_);
+        binding->identifier_ = binding->identifier_->Replace(context, CYIdentifierLexical);
+        if (binding->initializer_ == NULL)
+            continue;
+        context.Replace(binding->initializer_);
+        CYExpression *assignment($ CYAssign(binding->Target(context), binding->initializer_));
+        CYReplaceConstant(context, binding);
+        expression = expression == NULL ? assignment : $ CYCompound(expression, assignment);
+    }
+
+    if (expression == NULL)
+        return $ CYEmpty();
+    return $E(expression);
+}
+
+CYExpression *CYLogicalAnd::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    switch (CYReplaceTruth(context, lhs_)) {
+        case 0: return lhs_;
+        case 1: return rhs_;
+    }
+
+    return this;
+}
+
+CYExpression *CYLogicalNot::Replace(CYContext &context) {
+    CYPrefix::Replace(context);
+
+    int truth(CYReplaceTruth(context, rhs_));
+    if (truth == -1)
+        return this;
+    return CYReplaceBoolean(context, !truth);
+}
+
+CYExpression *CYLogicalOr::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    switch (CYReplaceTruth(context, lhs_)) {
+        case 0: return rhs_;
+        case 1: return lhs_;
+    }
+
+    return this;
+}
+
 CYFunctionExpression *CYMethod::Constructor() {
     return NULL;
 }
@@ -717,12 +1299,24 @@ CYString *CYModule::Replace(CYContext &context, const char *separator) const {
     return $ CYString($pool.strcat(next_->Replace(context, separator)->Value(), separator, part_->Word(), NULL));
 }
 
+CYExpression *CYModulus::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            if (CYExpression *value = CYReplaceNumber(context, std::fmod(lhn->Value(), rhn->Value())))
+                return value;
+
+    return this;
+}
+
 CYExpression *CYMultiply::Replace(CYContext &context) {
     CYInfix::Replace(context);
 
     if (CYNumber *lhn = lhs_->Number(context))
         if (CYNumber *rhn = rhs_->Number(context))
-            return $D(lhn->Value() * rhn->Value());
+            if (CYExpression *value = CYReplaceNumber(context, lhn->Value() * rhn->Value()))
+                return value;
 
     return this;
 }
@@ -743,6 +1337,44 @@ CYTarget *New::Replace(CYContext &context) {
 
 } }
 
+CYNumber *CYNegate::Number(CYContext &context) {
+    if (CYNumber *number = rhs_->Number(context))
+        return $D(-number->Value());
+    return NULL;
+}
+
+CYExpression *CYNegate::Replace(CYContext &context) {
+    CYPrefix::Replace(context);
+
+    // a negative number is written as the negation of a literal, so that is as far as this folds
+    if (dynamic_cast<CYNumber *>(rhs_) != NULL)
+        return this;
+
+    if (CYNumber *number = rhs_->Number(context))
+        if (CYExpression *value = CYReplaceNumber(context, -number->Value()))
+            return value;
+
+    return this;
+}
+
+CYExpression *CYNotEqual::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    int equal(CYReplaceEqual(context, lhs_, rhs_, false));
+    if (equal == -1)
+        return this;
+    return CYReplaceBoolean(context, !equal);
+}
+
+CYExpression *CYNotIdentical::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    int equal(CYReplaceEqual(context, lhs_, rhs_, true));
+    if (equal == -1)
+        return this;
+    return CYReplaceBoolean(context, !equal);
+}
+
 CYNumber *CYNull::Number(CYContext &context) {
     return $D(0);
 }
@@ -755,13 +1387,40 @@ CYNumber *CYNumber::Number(CYContext &context) {
     return this;
 }
 
+// %.17g matches JavaScript's ToString only when it is the shortest form that reads back as the same number and uses no
+// exponent; anything else (0.1 prints as 0.10000000000000001) is left for the engine to convert at run time
 CYString *CYNumber::String(CYContext &context) {
-    // XXX: there is a precise algorithm for this
-    return $S($pool.sprintf(24, "%.17g", Value()));
+    double value(Value());
+    if (!std::isfinite(value) || (value == 0 && std::signbit(value)))
+        return NULL;
+
+    const char *string($pool.sprintf(24, "%.17g", value));
+    if (strchr(string, 'e') != NULL)
+        return NULL;
+
+    size_t shortest(1);
+    for (char buffer[32]; shortest != 17; ++shortest) {
+        snprintf(buffer, sizeof(buffer), "%.*g", int(shortest), value);
+        if (strtod(buffer, NULL) == value)
+            break;
+    }
+
+    const char *begin(string), *end(string + strlen(string));
+    while (begin != end && (*begin < '1' || *begin > '9'))
+        ++begin;
+    while (end != begin && (end[-1] == '0' || end[-1] == '.'))
+        --end;
+    size_t digits(end - begin - std::count(begin, end, '.'));
+
+    if (digits > shortest)
+        return NULL;
+    return $S(string);
 }
 
 CYExpression *CYNumber::PropertyName(CYContext &context) {
-    return String(context);
+    if (CYString *string = String(context))
+        return string;
+    return this;
 }
 
 CYTarget *CYObject::Replace(CYContext &context, CYTarget *seed) {
@@ -785,14 +1444,32 @@ CYTarget *CYObject::Replace(CYContext &context) {
     return Replace(context, this);
 }
 
+CYNumber *CYParenthetical::Number(CYContext &context) {
+    return expression_->Number(context);
+}
+
 CYTarget *CYParenthetical::Replace(CYContext &context) {
     // XXX: return expression_;
     context.Replace(expression_);
+    // a string stays in its parentheses, where it cannot be read as a directive, and so does a regular expression
+    if (CYTrivial *trivial = dynamic_cast<CYTrivial *>(expression_))
+        if (CYReplaceType(trivial) != NULL && dynamic_cast<CYString *>(trivial) == NULL)
+            return trivial;
     return this;
 }
 
 CYExpression *CYPostfix::Replace(CYContext &context) {
-    context.Replace(lhs_);
+    CYReplaceWritten(context, lhs_);
+    return this;
+}
+
+CYExpression *CYPreDecrement::Replace(CYContext &context) {
+    CYReplaceWritten(context, rhs_);
+    return this;
+}
+
+CYExpression *CYPreIncrement::Replace(CYContext &context) {
+    CYReplaceWritten(context, rhs_);
     return this;
 }
 
@@ -886,9 +1563,11 @@ void CYScript::Replace(CYContext &context) {
 
     for (std::vector<CYIdentifier *>::const_iterator i(context.replace_.begin()); i != context.replace_.end(); ++i) {
         const char *name;
-        if (context.options_.verbose_)
-            name = $pool.strcat("$", $pool.itoa(offset++), NULL);
-        else {
+        if (context.options_.verbose_) {
+            CYBuffer buffer($pool, 8);
+            buffer << '$' << offset++;
+            name = buffer.Finish();
+        } else {
             char id[8];
             id[7] = '\0';
 
@@ -919,6 +1598,15 @@ CYTarget *CYResolveMember::Replace(CYContext &context) {
 }
 
 CYStatement *CYReturn::Replace(CYContext &context) {
+    if (CYEscape *escape = context.escape_) {
+        escape->used_ = true;
+        value_ = $ CYCompound($ CYAssign($V(escape->flag_), $ CYTrue()), $ CYAssign($V(escape->value_), value_ == NULL ? $U : value_));
+        if (CYExpression *stop = escape->Stop())
+            value_ = $ CYCompound(value_, stop);
+        context.Replace(value_);
+        return this;
+    }
+
     if (context.nonlocal_ != NULL) {
         CYProperty *value(value_ == NULL ? NULL : $ CYPropertyValue($S("$cyv"), value_));
         return $ cy::Syntax::Throw($ CYObject(
@@ -973,19 +1661,25 @@ CYIdentifierFlags *CYScope::Lookup(CYContext &context, CYIdentifier *identifier)
     return Lookup(context, identifier->Word());
 }
 
-CYIdentifierFlags *CYScope::Declare(CYContext &context, CYIdentifier *identifier, CYIdentifierKind kind) {
+CYIdentifierFlags *CYScope::Declare(CYContext &context, CYIdentifier *identifier, CYIdentifierKind kind, bool declared) {
     _assert(identifier->next_ == NULL || identifier->next_ == identifier);
 
     CYIdentifierFlags *existing(Lookup(context, identifier));
-    if (existing == NULL)
+    if (existing == NULL) {
         internal_ = $ CYIdentifierFlags(identifier, kind, internal_);
-    ++internal_->count_;
-    if (existing == NULL)
+        ++internal_->count_;
+        internal_->declared_ = declared;
         return internal_;
+    }
+
+    ++existing->count_;
 
     if (kind == CYIdentifierGlobal);
-    else if (existing->kind_ == CYIdentifierGlobal || existing->kind_ == CYIdentifierMagic)
+    else if (existing->kind_ == CYIdentifierGlobal || existing->kind_ == CYIdentifierMagic) {
         existing->kind_ = kind;
+        existing->declared_ = declared;
+    } else if (existing->kind_ == CYIdentifierVariable && kind == CYIdentifierVariable)
+        existing->declared_ &= declared;
     else if (existing->kind_ == CYIdentifierLexical || kind == CYIdentifierLexical)
         _assert(false);
     else if (transparent_ && existing->kind_ == CYIdentifierArgument && kind == CYIdentifierVariable)
@@ -1006,12 +1700,15 @@ void CYScope::Merge(CYContext &context, const CYIdentifierFlags *flags) {
 }
 
 void CYScope::Close(CYContext &context, CYStatement *&statements) {
+    if (context.options_.minify_ && !transparent_ && !damaged_)
+        Sweep(context, statements);
+
     Close(context);
 
     CYList<CYBindings> bindings;
 
     CYForEach (i, internal_)
-        if (i->kind_ == CYIdentifierVariable)
+        if (i->kind_ == CYIdentifierVariable && !i->declared_)
             bindings
                 ->* $ CYBindings($ CYBinding(i->identifier_));
 
@@ -1036,15 +1733,19 @@ void CYScope::Close(CYContext &context) {
                 i->identifier_ = replace;
             }
 
-            if (!transparent_)
+            // native declarations stay where they are, but their names are still allocated as variables
+            bool declared(context.options_.standard_ >= CYStandardES2015);
+
+            if (!transparent_) {
                 i->kind_ = CYIdentifierVariable;
-            else
-                parent_->Declare(context, i->identifier_, CYIdentifierVariable);
+                i->declared_ = declared;
+            } else
+                parent_->Declare(context, i->identifier_, CYIdentifierVariable, declared);
         } break;
 
         case CYIdentifierVariable: {
             if (transparent_) {
-                parent_->Declare(context, i->identifier_, i->kind_);
+                parent_->Declare(context, i->identifier_, i->kind_, i->declared_);
                 i->kind_ = CYIdentifierGlobal;
             }
         } break;
@@ -1097,8 +1798,90 @@ void CYScope::Close(CYContext &context) {
     default:; } }
 }
 
+// a function, or a variable assigned something without effects, that is declared here and never used is dropped;
+// the name was only declared once and that declaration is its one use, so it is marked as needing no var either
+void CYScope::Sweep(CYContext &context, CYStatement *&statements) {
+    for (CYStatement **last(&statements); *last != NULL; ) {
+        CYStatement *statement(*last);
+
+        CYIdentifier *name(NULL);
+        CYExpression *value(NULL);
+        bool function(false);
+
+        if (CYFunctionStatement *declaration = dynamic_cast<CYFunctionStatement *>(statement)) {
+            name = declaration->name_;
+            function = true;
+        } else if (CYLexical *lexical = dynamic_cast<CYLexical *>(statement)) {
+            if (lexical->bindings_->next_ == NULL) {
+                name = lexical->bindings_->binding_->identifier_;
+                value = lexical->bindings_->binding_->initializer_;
+            }
+        } else if (CYExpress *express = dynamic_cast<CYExpress *>(statement))
+            if (CYAssign *assign = dynamic_cast<CYAssign *>(express->expression_))
+                if (CYVariable *variable = dynamic_cast<CYVariable *>(assign->lhs_)) {
+                    name = variable->name_;
+                    value = assign->rhs_;
+                }
+
+        CYIdentifierFlags *flags(NULL);
+        if (name != NULL && (value == NULL || CYReplaceType(value) != NULL || dynamic_cast<CYTrivial *>(value) != NULL || dynamic_cast<CYFunctionExpression *>(value) != NULL))
+            flags = Lookup(context, name);
+
+        bool unused(flags != NULL && flags->identifier_ == name && flags->count_ == 1);
+        if (unused) {
+            if (function)
+                unused = flags->kind_ == CYIdentifierOther;
+            else
+                unused = flags->kind_ == CYIdentifierVariable || flags->kind_ == CYIdentifierLexical;
+        }
+
+        if (!unused)
+            last = &statement->next_;
+        else {
+            flags->kind_ = CYIdentifierOther;
+            *last = statement->next_;
+        }
+    }
+}
+
+CYExpression *CYShiftLeft::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            if (CYExpression *value = CYReplaceNumber(context, int32_t(CYReplaceUInt32(lhn->Value()) << (CYReplaceUInt32(rhn->Value()) & 0x1f))))
+                return value;
+
+    return this;
+}
+
+CYExpression *CYShiftRightSigned::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            if (CYExpression *value = CYReplaceNumber(context, CYReplaceInt32(lhn->Value()) >> (CYReplaceUInt32(rhn->Value()) & 0x1f)))
+                return value;
+
+    return this;
+}
+
+CYExpression *CYShiftRightUnsigned::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            if (CYExpression *value = CYReplaceNumber(context, CYReplaceUInt32(lhn->Value()) >> (CYReplaceUInt32(rhn->Value()) & 0x1f)))
+                return value;
+
+    return this;
+}
+
 CYTarget *CYSubscriptMember::Replace(CYContext &context) {
-    return $C1($M(object_, $S("$cyg")), property_);
+    CYExpression *replace(CYReplaceSubscript(context, this, NULL));
+    if (CYTarget *target = dynamic_cast<CYTarget *>(replace))
+        return target;
+    return $ CYParenthetical(replace);
 }
 
 CYElementValue *CYSpan::Replace(CYContext &context) { $T(NULL)
@@ -1110,12 +1893,10 @@ CYStatement *CYStatement::Return() {
 }
 
 CYString *CYString::Concat(CYContext &context, CYString *rhs) const {
-    size_t size(size_ + rhs->size_);
-    char *value($ char[size + 1]);
-    memcpy(value, value_, size_);
-    memcpy(value + size_, rhs->value_, rhs->size_);
-    value[size] = '\0';
-    return $S(value, size);
+    CYBuffer value($pool, size_ + rhs->size_ + 1);
+    value.Write(value_, size_).Write(rhs->value_, rhs->size_);
+    size_t size(value.Size());
+    return $S(value.Finish(), size);
 }
 
 CYIdentifier *CYString::Identifier() const {
@@ -1162,11 +1943,32 @@ CYTarget *CYStructTail::Replace(CYContext &context) {
     return $N2($V("Type"), $ CYArray(types), $ CYArray(names));
 }
 
+CYExpression *CYSubtract::Replace(CYContext &context) {
+    CYInfix::Replace(context);
+
+    if (CYNumber *lhn = lhs_->Number(context))
+        if (CYNumber *rhn = rhs_->Number(context))
+            if (CYExpression *value = CYReplaceNumber(context, lhn->Value() - rhn->Value()))
+                return value;
+
+    return this;
+}
+
 CYTarget *CYSuperAccess::Replace(CYContext &context) {
+    if (context.super_ == NULL && context.options_.standard_ >= CYStandardES2015) {
+        context.Replace(property_);
+        return this;
+    }
+
     return $C1($M($M($M($V(context.super_), $S("prototype")), property_), $S("bind")), $ CYThis());
 }
 
 CYTarget *CYSuperCall::Replace(CYContext &context) {
+    if (context.super_ == NULL && context.options_.standard_ >= CYStandardES2015) {
+        arguments_->Replace(context);
+        return this;
+    }
+
     return $C($C1($M($V(context.super_), $S("bind")), $ CYThis()), arguments_);
 }
 
@@ -1187,6 +1989,12 @@ CYStatement *CYTarget::Initialize(CYContext &context, CYExpression *value) {
 }
 
 CYTarget *CYTemplate::Replace(CYContext &context) {
+    if (context.options_.standard_ >= CYStandardES2015) {
+        CYForEach (span, spans_)
+            context.Replace(span->expression_);
+        return this;
+    }
+
     return $C2($M($M($M($V("String"), $S("prototype")), $S("concat")), $S("apply")), $S(""), $ CYArray($ CYElementValue(string_, spans_->Replace(context))));
 }
 
@@ -1198,7 +2006,8 @@ CYString *CYTemplate::String(CYContext &context) {
 }
 
 CYTarget *CYThis::Replace(CYContext &context) {
-    if (context.this_ != NULL)
+    // arrow functions are native from ES2015 on, so nothing needs this captured into a variable
+    if (context.this_ != NULL && context.options_.standard_ < CYStandardES2015)
         return $V(context.this_->Identifier(context));
     return this;
 }
@@ -1244,6 +2053,16 @@ CYTarget *CYTypeArrayOf::Replace_(CYContext &context, CYTarget *type) {
     return next_->Replace(context, $ CYCall($ CYDirectMember(type, $ CYString("arrayOf")), $ CYArgument(size_)));
 }
 
+sig::Type *CYTypeArrayOf::Encode(CYContext &context, sig::Type *type, bool exact) const {
+    CYNumber *size(dynamic_cast<CYNumber *>(size_));
+    if (size == NULL || size->value_ < 0 || size->value_ != size_t(size->value_))
+        return NULL;
+    // the element type is encoded without its qualifiers
+    if (exact && type->flags != 0)
+        return NULL;
+    return $ sig::Array(*type, size_t(size->value_));
+}
+
 CYTarget *CYTypeBlockWith::Replace_(CYContext &context, CYTarget *type) {
     return next_->Replace(context, $ CYCall($ CYDirectMember(type, $ CYString("blockWith")), parameters_->Argument(context)));
 }
@@ -1257,6 +2076,21 @@ CYTarget *CYTypeCharacter::Replace(CYContext &context) {
     }
 }
 
+sig::Type *CYTypeCharacter::Encode(CYContext &context, bool exact) const {
+    switch (signing_) {
+        // a plain char encodes as a signed one
+        case CYTypeNeutral: return exact ? NULL : $ sig::Primitive<char>();
+        case CYTypeSigned: return $ sig::Primitive<signed char>();
+        case CYTypeUnsigned: return $ sig::Primitive<unsigned char>();
+        default: _assert(false);
+    }
+}
+
+sig::Type *CYTypeConstant::Encode(CYContext &context, sig::Type *type, bool exact) const {
+    type->flags |= JOC_TYPE_CONST;
+    return type;
+}
+
 CYTarget *CYTypeConstant::Replace_(CYContext &context, CYTarget *type) {
     return next_->Replace(context, $ CYCall($ CYDirectMember(type, $ CYString("constant"))));
 }
@@ -1286,6 +2120,15 @@ CYTarget *CYTypeExpression::Replace(CYContext &context) {
     return typed_->Replace(context);
 }
 
+sig::Type *CYTypeFloating::Encode(CYContext &context, bool exact) const {
+    switch (length_) {
+        case 0: return $ sig::Primitive<float>();
+        case 1: return $ sig::Primitive<double>();
+        case 2: return $ sig::Primitive<long double>();
+        default: _assert(false);
+    }
+}
+
 CYTarget *CYTypeFloating::Replace(CYContext &context) {
     switch (length_) {
         case 0: return $V("float");
@@ -1295,10 +2138,31 @@ CYTarget *CYTypeFloating::Replace(CYContext &context) {
     }
 }
 
+sig::Type *CYTypeInt128::Encode(CYContext &context, bool exact) const {
+#ifdef __SIZEOF_INT128__
+    if (signing_ == CYTypeUnsigned)
+        return $ sig::Primitive<unsigned __int128>();
+    return $ sig::Primitive<signed __int128>();
+#else
+    return NULL;
+#endif
+}
+
 CYTarget *CYTypeInt128::Replace(CYContext &context) {
     return $V(signing_ == CYTypeUnsigned ? "uint128" : "int128");
 }
 
+sig::Type *CYTypeIntegral::Encode(CYContext &context, bool exact) const {
+    bool u(signing_ == CYTypeUnsigned);
+    switch (length_) {
+        case 0: return u ? (sig::Type *) $ sig::Primitive<unsigned short int>() : $ sig::Primitive<signed short int>();
+        case 1: return u ? (sig::Type *) $ sig::Primitive<unsigned int>() : $ sig::Primitive<signed int>();
+        case 2: return u ? (sig::Type *) $ sig::Primitive<unsigned long int>() : $ sig::Primitive<signed long int>();
+        case 3: return u ? (sig::Type *) $ sig::Primitive<unsigned long long int>() : $ sig::Primitive<signed long long int>();
+        default: _assert(false);
+    }
+}
+
 CYTarget *CYTypeIntegral::Replace(CYContext &context) {
     bool u(signing_ == CYTypeUnsigned);
     switch (length_) {
@@ -1321,6 +2185,21 @@ CYTarget *CYTypeFunctionWith::Replace_(CYContext &context, CYTarget *type) {
     return next_->Replace(context, $ CYCall($ CYDirectMember(type, $ CYString("functionWith")), arguments));
 }
 
+CYExpression *CYTypeOf::Replace(CYContext &context) {
+    CYPrefix::Replace(context);
+
+    if (const char *type = CYReplaceType(rhs_))
+        return $S(type);
+    return this;
+}
+
+sig::Type *CYTypePointerTo::Encode(CYContext &context, sig::Type *type, bool exact) const {
+    // the pointee is encoded without its qualifiers
+    if (exact && type->flags != 0)
+        return NULL;
+    return $ sig::Pointer(*type);
+}
+
 CYTarget *CYTypePointerTo::Replace_(CYContext &context, CYTarget *type) {
     return next_->Replace(context, $ CYCall($ CYDirectMember(type, $ CYString("pointerTo"))));
 }
@@ -1343,10 +2222,31 @@ CYTarget *CYTypeStruct::Replace(CYContext &context) {
     return target;
 }
 
+sig::Type *CYTypeVariable::Encode(CYContext &context, bool exact) const {
+#if CY_OBJECTIVEC
+    // these are only equivalent once the runtime has encoded them again
+    if (!exact) {
+        const char *name(name_->Word());
+        if (strcmp(name, "id") == 0)
+            return $ sig::Object();
+        if (strcmp(name, "Class") == 0)
+            return $ sig::Meta();
+        if (strcmp(name, "SEL") == 0)
+            return $ sig::Selector();
+    }
+#endif
+
+    return NULL;
+}
+
 CYTarget *CYTypeVariable::Replace(CYContext &context) {
     return $V(name_);
 }
 
+sig::Type *CYTypeVoid::Encode(CYContext &context, bool exact) const {
+    return $ sig::Void();
+}
+
 CYTarget *CYTypeVoid::Replace(CYContext &context) {
     return $N1($V("Type"), $ CYString("v"));
 }
@@ -1356,9 +2256,21 @@ CYTarget *CYTypeVolatile::Replace_(CYContext &context, CYTarget *type) {
 }
 
 CYTarget *CYType::Replace(CYContext &context) {
+    // the runtime parses one encoding rather than taking a call per modifier
+    if (modifier_ != NULL)
+        if (const char *encoding = Encoding(context, true))
+            return $N1($V("Type"), $S(encoding));
+
     return modifier_->Replace(context, specifier_->Replace(context));
 }
 
+const char *CYType::Encoding(CYContext &context, bool exact) const {
+    sig::Type *type(specifier_->Encode(context, exact));
+    for (CYTypeModifier *modifier(modifier_); type != NULL && modifier != NULL; modifier = modifier->next_)
+        type = modifier->Encode(context, type, exact);
+    return type == NULL ? NULL : sig::Unparse($pool, type);
+}
+
 CYTypeFunctionWith *CYType::Function() {
     CYTypeModifier *&modifier(CYGetLast(modifier_));
     if (modifier == NULL)
@@ -1392,6 +2304,8 @@ CYForInitializer *CYVar::Replace(CYContext &context) {
 
 CYTarget *CYVariable::Replace(CYContext &context) {
     name_ = name_->Replace(context, CYIdentifierGlobal);
+    if (CYTrivial *constant = CYReplaceConstant(context, name_))
+        return constant;
     return this;
 }
 
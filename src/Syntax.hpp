@@ -61,6 +61,10 @@ CYUTF8String CYPoolFileUTF8String(CYPool &pool, const char *path);
 
 struct CYContext;
 
+namespace sig {
+struct Type;
+}
+
 struct CYThing {
     virtual void Output(struct CYOutput &out) const = 0;
 };
@@ -225,6 +229,8 @@ struct CYStatement :
     virtual void Output(CYOutput &out) const;
 
     virtual CYStatement *Replace(CYContext &context) = 0;
+    // a statement in a list may lower into one that is already replaced; a for initializer only gets Replace
+    virtual CYStatement *Expand(CYContext &context) { return this; }
 
     virtual CYCompactType Compact() const = 0;
     virtual CYStatement *Return();
@@ -336,6 +342,8 @@ struct CYIdentifierValueLess :
     }
 };
 
+struct CYTrivial;
+
 struct CYIdentifierFlags :
     CYNext<CYIdentifierFlags>
 {
@@ -343,13 +351,19 @@ struct CYIdentifierFlags :
     CYIdentifierKind kind_;
     unsigned count_;
     unsigned offset_;
+    // a native let, const or class declares this itself, so the scope must not hoist a var for it
+    bool declared_;
+    // the literal a const was initialized to, which later uses in the same function read instead
+    CYTrivial *constant_;
 
     CYIdentifierFlags(CYIdentifier *identifier, CYIdentifierKind kind, CYIdentifierFlags *next = NULL) :
         CYNext<CYIdentifierFlags>(next),
         identifier_(identifier),
         kind_(kind),
         count_(0),
-        offset_(0)
+        offset_(0),
+        declared_(false),
+        constant_(NULL)
     {
     }
 };
@@ -367,12 +381,13 @@ struct CYScope {
     CYIdentifierFlags *Lookup(CYContext &context, const char *word);
     CYIdentifierFlags *Lookup(CYContext &context, CYIdentifier *identifier);
 
-    CYIdentifierFlags *Declare(CYContext &context, CYIdentifier *identifier, CYIdentifierKind kind);
+    CYIdentifierFlags *Declare(CYContext &context, CYIdentifier *identifier, CYIdentifierKind kind, bool declared = false);
     void Merge(CYContext &context, const CYIdentifierFlags *flags);
 
     void Close(CYContext &context, CYStatement *&statements);
     void Close(CYContext &context);
     void Damage();
+    void Sweep(CYContext &context, CYStatement *&statements);
 };
 
 struct CYScript :
@@ -389,6 +404,7 @@ struct CYScript :
     virtual void Output(CYOutput &out) const;
 };
 
+struct CYEscape;
 struct CYNonLocal;
 struct CYThisScope;
 
@@ -401,6 +417,7 @@ struct CYContext {
 
     CYNonLocal *nonlocal_;
     CYNonLocal *nextlocal_;
+    CYEscape *escape_;
     unsigned unique_;
 
     std::vector<CYIdentifier *> replace_;
@@ -412,22 +429,31 @@ struct CYContext {
         super_(NULL),
         nonlocal_(NULL),
         nextlocal_(NULL),
+        escape_(NULL),
         unique_(0)
     {
     }
 
     void ReplaceAll(CYStatement *&statement) {
-        if (statement == NULL)
-            return;
-        CYStatement *next(statement->next_);
-
-        Replace(statement);
-        ReplaceAll(next);
+        for (CYStatement **last(&statement); *last != NULL; ) {
+            CYStatement *next((*last)->next_);
+
+            CYStatement *expand((*last)->Expand(*this));
+            if (expand != *last)
+                *last = expand;
+            else
+                Replace(*last);
+
+            if (*last == NULL)
+                *last = next;
+            else {
+                (*last)->SetNext(next);
+                last = &(*last)->next_;
+            }
+        }
 
-        if (statement == NULL)
-            statement = next;
-        else
-            statement->SetNext(next);
+        if (options_.minify_)
+            Prune(statement);
     }
 
     template <typename Type_>
@@ -443,6 +469,7 @@ struct CYContext {
     }
 
     void NonLocal(CYStatement *&statements);
+    void Prune(CYStatement *&statements);
     CYIdentifier *Unique();
 };
 
@@ -461,6 +488,31 @@ struct CYNonLocal {
     }
 };
 
+// what a callback returns to make the helper calling it stop early, if anything does
+enum CYEscapeStop {
+    CYEscapeNever,
+    CYEscapeTrue,
+    CYEscapeFalse,
+};
+
+// a return in a block that an iteration helper calls directly sets these and leaves the block, rather than throwing
+struct CYEscape {
+    CYIdentifier *flag_;
+    CYIdentifier *value_;
+    CYEscapeStop stop_;
+    bool used_;
+
+    CYEscape(CYContext &context, CYEscapeStop stop) :
+        flag_(context.Unique()),
+        value_(context.Unique()),
+        stop_(stop),
+        used_(false)
+    {
+    }
+
+    CYExpression *Stop() const;
+};
+
 struct CYThisScope :
     CYNext<CYThisScope>
 {
@@ -617,6 +669,8 @@ struct CYParenthetical :
 
     CYPrecedence(0)
 
+    virtual CYNumber *Number(CYContext &context);
+
     virtual CYTarget *Replace(CYContext &context);
     void Output(CYOutput &out, CYFlags flags) const;
 };
@@ -1091,6 +1145,11 @@ struct CYAssignment :
 
     virtual const char *Operator() const = 0;
 
+    // the value a compound assignment stores, given the target's value; a plain one stores rhs as is
+    virtual CYExpression *Combine(CYExpression *lhs, CYExpression *rhs) const {
+        return rhs;
+    }
+
     CYPrecedence(16)
 
     virtual CYExpression *Replace(CYContext &context);
@@ -1306,7 +1365,8 @@ struct CYLexical :
 
     CYCompact(None)
 
-    virtual CYForInitializer *Replace(CYContext &context);
+    CYForInitializer *Replace(CYContext &context) override;
+    CYStatement *Expand(CYContext &context) override;
     virtual void Output(CYOutput &out, CYFlags flags) const;
 };
 
@@ -1340,6 +1400,8 @@ struct CYProperty :
 
     virtual void Replace(CYContext &context) = 0;
     virtual void Output(CYOutput &out) const;
+    // the definition without the separator an object literal needs, as it appears in a class body
+    virtual void Define(CYOutput &out) const = 0;
 };
 
 struct CYPropertyValue :
@@ -1356,6 +1418,7 @@ struct CYPropertyValue :
     virtual void Replace(CYContext &context, CYBuilder &builder, CYExpression *self, CYExpression *name, bool protect);
     virtual void Replace(CYContext &context);
     virtual void Output(CYOutput &out) const;
+    virtual void Define(CYOutput &out) const;
 };
 
 struct CYFor :
@@ -1730,6 +1793,7 @@ struct CYFunction {
     CYStatement *code_;
 
     CYNonLocal *nonlocal_;
+    CYEscape *escape_;
     bool implicit_;
     CYThisScope this_;
     CYIdentifier *super_;
@@ -1738,6 +1802,7 @@ struct CYFunction {
         parameters_(parameters),
         code_(code),
         nonlocal_(NULL),
+        escape_(NULL),
         implicit_(false),
         super_(NULL)
     {
@@ -1774,7 +1839,7 @@ struct CYFatArrow :
     {
     }
 
-    CYPrecedence(0)
+    CYPrecedence(CYAssignment::Precedence_)
 
     CYExpression *Replace(CYContext &context) override;
     virtual void Output(CYOutput &out, CYFlags flags) const;
@@ -1841,6 +1906,7 @@ struct CYPropertyGetter :
 
     virtual void Replace(CYContext &context, CYBuilder &builder, CYExpression *self, CYExpression *name, bool protect);
     virtual void Output(CYOutput &out) const;
+    virtual void Define(CYOutput &out) const;
 };
 
 struct CYPropertySetter :
@@ -1853,6 +1919,7 @@ struct CYPropertySetter :
 
     virtual void Replace(CYContext &context, CYBuilder &builder, CYExpression *self, CYExpression *name, bool protect);
     virtual void Output(CYOutput &out) const;
+    virtual void Define(CYOutput &out) const;
 };
 
 struct CYPropertyMethod :
@@ -1869,6 +1936,7 @@ struct CYPropertyMethod :
 
     virtual void Replace(CYContext &context, CYBuilder &builder, CYExpression *self, CYExpression *name, bool protect);
     virtual void Output(CYOutput &out) const;
+    virtual void Define(CYOutput &out) const;
 };
 
 struct CYClassTail :
@@ -1886,6 +1954,9 @@ struct CYClassTail :
     {
     }
 
+    // extends and computed keys are evaluated outside the class's own scope, so they are replaced in the enclosing one
+    void Outer(CYContext &context);
+    void Replace(CYContext &context);
     void Output(CYOutput &out) const;
 };
 
@@ -1972,6 +2043,7 @@ struct CYExpress :
     CYCompact(None)
 
     CYForInitializer *Replace(CYContext &context) override;
+    CYStatement *Expand(CYContext &context) override;
     virtual void Output(CYOutput &out, CYFlags flags) const;
 
     virtual CYStatement *Return();
@@ -2084,6 +2156,9 @@ struct CYTypeSpecifier :
     CYThing
 {
     virtual CYTarget *Replace(CYContext &context) = 0;
+
+    // exact only allows what parses back to the same type, rather than just to the same encoding
+    virtual sig::Type *Encode(CYContext &context, bool exact) const { return NULL; }
 };
 
 struct CYTypeError :
@@ -2113,6 +2188,7 @@ struct CYTypeCharacter :
     }
 
     virtual CYTarget *Replace(CYContext &context);
+    virtual sig::Type *Encode(CYContext &context, bool exact) const;
     virtual void Output(CYOutput &out) const;
 };
 
@@ -2127,6 +2203,7 @@ struct CYTypeInt128 :
     }
 
     virtual CYTarget *Replace(CYContext &context);
+    virtual sig::Type *Encode(CYContext &context, bool exact) const;
     virtual void Output(CYOutput &out) const;
 };
 
@@ -2171,6 +2248,7 @@ struct CYTypeIntegral :
     }
 
     virtual CYTarget *Replace(CYContext &context);
+    virtual sig::Type *Encode(CYContext &context, bool exact) const;
     virtual void Output(CYOutput &out) const;
 };
 
@@ -2185,6 +2263,7 @@ struct CYTypeFloating :
     }
 
     virtual CYTarget *Replace(CYContext &context);
+    virtual sig::Type *Encode(CYContext &context, bool exact) const;
     virtual void Output(CYOutput &out) const;
 };
 
@@ -2195,6 +2274,7 @@ struct CYTypeVoid :
     }
 
     virtual CYTarget *Replace(CYContext &context);
+    virtual sig::Type *Encode(CYContext &context, bool exact) const;
     virtual void Output(CYOutput &out) const;
 };
 
@@ -2235,6 +2315,7 @@ struct CYTypeVariable :
     }
 
     virtual CYTarget *Replace(CYContext &context);
+    virtual sig::Type *Encode(CYContext &context, bool exact) const;
     virtual void Output(CYOutput &out) const;
 };
 
@@ -2253,6 +2334,8 @@ struct CYTypeModifier :
     virtual CYTarget *Replace_(CYContext &context, CYTarget *type) = 0;
     CYTarget *Replace(CYContext &context, CYTarget *type);
 
+    virtual sig::Type *Encode(CYContext &context, sig::Type *type, bool exact) const { return NULL; }
+
     virtual void Output(CYOutput &out, CYPropertyName *name) const = 0;
     void Output(CYOutput &out, int precedence, CYPropertyName *name, bool space) const;
 
@@ -2273,6 +2356,7 @@ struct CYTypeArrayOf :
     CYPrecedence(1)
 
     virtual CYTarget *Replace_(CYContext &context, CYTarget *type);
+    virtual sig::Type *Encode(CYContext &context, sig::Type *type, bool exact) const;
     void Output(CYOutput &out, CYPropertyName *name) const override;
 };
 
@@ -2287,6 +2371,7 @@ struct CYTypeConstant :
     CYPrecedence(0)
 
     virtual CYTarget *Replace_(CYContext &context, CYTarget *type);
+    virtual sig::Type *Encode(CYContext &context, sig::Type *type, bool exact) const;
     void Output(CYOutput &out, CYPropertyName *name) const override;
 };
 
@@ -2301,6 +2386,7 @@ struct CYTypePointerTo :
     CYPrecedence(0)
 
     virtual CYTarget *Replace_(CYContext &context, CYTarget *type);
+    virtual sig::Type *Encode(CYContext &context, sig::Type *type, bool exact) const;
     void Output(CYOutput &out, CYPropertyName *name) const override;
 };
 
@@ -2340,6 +2426,9 @@ struct CYType :
     virtual CYTarget *Replace(CYContext &context);
     virtual void Output(CYOutput &out) const;
 
+    // the signature encoding when every part of the type is known at compile time, otherwise NULL
+    const char *Encoding(CYContext &context, bool exact) const;
+
     CYTypeFunctionWith *Function();
 };
 
@@ -2868,6 +2957,14 @@ struct CYIndirect :
 #define CYReplace \
     virtual CYExpression *Replace(CYContext &context);
 
+#define CYNumeric \
+    virtual CYNumber *Number(CYContext &context);
+
+#define CYCombine(name) \
+    virtual CYExpression *Combine(CYExpression *lhs, CYExpression *rhs) const { \
+        return new($pool) CY ## name(lhs, rhs); \
+    }
+
 #define CYPostfix_(op, name, ...) \
     struct CY ## name : \
         CYPostfix \
@@ -2932,52 +3029,52 @@ struct CYIndirect :
 CYPostfix_("++", PostIncrement)
 CYPostfix_("--", PostDecrement)
 
-CYPrefix_(true, "delete", Delete)
+CYPrefix_(true, "delete", Delete, CYReplace)
 CYPrefix_(true, "void", Void)
-CYPrefix_(true, "typeof", TypeOf)
-CYPrefix_(false, "++", PreIncrement)
-CYPrefix_(false, "--", PreDecrement)
-CYPrefix_(false, "+", Affirm)
-CYPrefix_(false, "-", Negate)
-CYPrefix_(false, "~", BitwiseNot)
-CYPrefix_(false, "!", LogicalNot)
+CYPrefix_(true, "typeof", TypeOf, CYReplace)
+CYPrefix_(false, "++", PreIncrement, CYReplace)
+CYPrefix_(false, "--", PreDecrement, CYReplace)
+CYPrefix_(false, "+", Affirm, CYReplace)
+CYPrefix_(false, "-", Negate, CYReplace CYNumeric)
+CYPrefix_(false, "~", BitwiseNot, CYReplace)
+CYPrefix_(false, "!", LogicalNot, CYReplace)
 
 CYInfix_(false, 5, "*", Multiply, CYReplace)
-CYInfix_(false, 5, "/", Divide)
-CYInfix_(false, 5, "%", Modulus)
+CYInfix_(false, 5, "/", Divide, CYReplace)
+CYInfix_(false, 5, "%", Modulus, CYReplace)
 CYInfix_(false, 6, "+", Add, CYReplace)
-CYInfix_(false, 6, "-", Subtract)
-CYInfix_(false, 7, "<<", ShiftLeft)
-CYInfix_(false, 7, ">>", ShiftRightSigned)
-CYInfix_(false, 7, ">>>", ShiftRightUnsigned)
-CYInfix_(false, 8, "<", Less)
-CYInfix_(false, 8, ">", Greater)
-CYInfix_(false, 8, "<=", LessOrEqual)
-CYInfix_(false, 8, ">=", GreaterOrEqual)
+CYInfix_(false, 6, "-", Subtract, CYReplace)
+CYInfix_(false, 7, "<<", ShiftLeft, CYReplace)
+CYInfix_(false, 7, ">>", ShiftRightSigned, CYReplace)
+CYInfix_(false, 7, ">>>", ShiftRightUnsigned, CYReplace)
+CYInfix_(false, 8, "<", Less, CYReplace)
+CYInfix_(false, 8, ">", Greater, CYReplace)
+CYInfix_(false, 8, "<=", LessOrEqual, CYReplace)
+CYInfix_(false, 8, ">=", GreaterOrEqual, CYReplace)
 CYInfix_(true, 8, "instanceof", InstanceOf)
 CYInfix_(true, 8, "in", In)
-CYInfix_(false, 9, "==", Equal)
-CYInfix_(false, 9, "!=", NotEqual)
-CYInfix_(false, 9, "===", Identical)
-CYInfix_(false, 9, "!==", NotIdentical)
-CYInfix_(false, 10, "&", BitwiseAnd)
-CYInfix_(false, 11, "^", BitwiseXOr)
-CYInfix_(false, 12, "|", BitwiseOr)
-CYInfix_(false, 13, "&&", LogicalAnd)
-CYInfix_(false, 14, "||", LogicalOr)
+CYInfix_(false, 9, "==", Equal, CYReplace)
+CYInfix_(false, 9, "!=", NotEqual, CYReplace)
+CYInfix_(false, 9, "===", Identical, CYReplace)
+CYInfix_(false, 9, "!==", NotIdentical, CYReplace)
+CYInfix_(false, 10, "&", BitwiseAnd, CYReplace)
+CYInfix_(false, 11, "^", BitwiseXOr, CYReplace)
+CYInfix_(false, 12, "|", BitwiseOr, CYReplace)
+CYInfix_(false, 13, "&&", LogicalAnd, CYReplace)
+CYInfix_(false, 14, "||", LogicalOr, CYReplace)
 
 CYAssignment_("=", )
-CYAssignment_("*=", Multiply)
-CYAssignment_("/=", Divide)
-CYAssignment_("%=", Modulus)
-CYAssignment_("+=", Add)
-CYAssignment_("-=", Subtract)
-CYAssignment_("<<=", ShiftLeft)
-CYAssignment_(">>=", ShiftRightSigned)
-CYAssignment_(">>>=", ShiftRightUnsigned)
-CYAssignment_("&=", BitwiseAnd)
-CYAssignment_("^=", BitwiseXOr)
-CYAssignment_("|=", BitwiseOr)
+CYAssignment_("*=", Multiply, CYCombine(Multiply))
+CYAssignment_("/=", Divide, CYCombine(Divide))
+CYAssignment_("%=", Modulus, CYCombine(Modulus))
+CYAssignment_("+=", Add, CYCombine(Add))
+CYAssignment_("-=", Subtract, CYCombine(Subtract))
+CYAssignment_("<<=", ShiftLeft, CYCombine(ShiftLeft))
+CYAssignment_(">>=", ShiftRightSigned, CYCombine(ShiftRightSigned))
+CYAssignment_(">>>=", ShiftRightUnsigned, CYCombine(ShiftRightUnsigned))
+CYAssignment_("&=", BitwiseAnd, CYCombine(BitwiseAnd))
+CYAssignment_("^=", BitwiseXOr, CYCombine(BitwiseXOr))
+CYAssignment_("|=", BitwiseOr, CYCombine(BitwiseOr))
 
 #ifdef __clang__
 # pragma clang diagnostic pop
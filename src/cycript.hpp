@@ -32,8 +32,6 @@
 double CYCastDouble(const char *value, size_t size);
 double CYCastDouble(const char *value);
 
-CYPool &CYGetGlobalPool();
-
 char **CYComplete(const char *word, const std::string &line, CYUTF8String (*run)(CYPool &pool, const std::string &));
 
 const char *CYPoolLibraryPath(CYPool &pool);
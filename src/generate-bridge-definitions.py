@@ -2,6 +2,7 @@
 from __future__ import print_function
 
 import codecs
+import os
 import subprocess
 import sys
 
@@ -13,6 +14,12 @@ bridge_old = sys.argv[5]
 output_file = sys.argv[6]
 extra_flags = sys.argv[7:]
 
+analysis_precompiled = None
+for flag in list(extra_flags):
+    if flag.startswith("--precompiled="):
+        analysis_precompiled = os.path.abspath(flag[len("--precompiled="):])
+        extra_flags.remove(flag)
+
 host_clang_arch = 'i386' if host_arch == 'x86' else host_arch
 
 host_flags = []
@@ -67,9 +74,23 @@ elif host_os == 'linux':
         "-D__extern_inline=extern inline",
     ] + system_includes
 
+# Analysis.cpp splits the Apple frameworks into CY_ANALYSIS_PART units, which Analyze parses in parallel
+analysis_parts = 3 if host_os in ('macos', 'ios') else 0
+
+# units whose included headers are unchanged since the last run are loaded from here instead of parsed
+analysis_cache = os.path.join(os.path.dirname(os.path.abspath(output_file)), "analysis-cache")
+for directory in [analysis_cache, analysis_precompiled]:
+    if directory is not None and not os.path.isdir(directory):
+        os.makedirs(directory)
+
 analyze_args = [
     analyze,
+    "-j", str(os.cpu_count() or 1),
+    "-p", str(analysis_parts),
+    "-c", analysis_cache,
+] + (["-P", analysis_precompiled] if analysis_precompiled is not None else []) + [
     analysis_cpp,
+    "--",
     "-O2",
 ] + host_flags + extra_flags
 definitions = subprocess.check_output(analyze_args).decode('utf-8')
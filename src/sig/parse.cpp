@@ -32,14 +32,6 @@ namespace sig {
 void Parse_(CYPool &pool, struct Signature *signature, const char **name, char eos, Callback callback);
 struct Type *Parse_(CYPool &pool, const char **name, char eos, bool named, Callback callback);
 
-
-/* XXX: I really screwed up this time */
-void *prealloc_(CYPool &pool, void *odata, size_t osize, size_t nsize) {
-    void *ndata(pool.malloc<void>(nsize));
-    memcpy(ndata, odata, osize);
-    return ndata;
-}
-
 void Parse_(CYPool &pool, struct Signature *signature, const char **name, char eos, Callback callback) {
     _assert(*name != NULL);
 
@@ -49,14 +41,22 @@ void Parse_(CYPool &pool, struct Signature *signature, const char **name, char e
     signature->elements = NULL;
     signature->count = 0;
 
+    // elements are parsed in place, so grow geometrically and copy what we have so far
+    size_t capacity(0);
+
     for (;;) {
         if (**name == eos) {
             ++*name;
             return;
         }
 
-        signature->elements = (struct Element *) prealloc_(pool, signature->elements, signature->count * sizeof(struct Element), (signature->count + 1) * sizeof(struct Element));
-        _assert(signature->elements != NULL);
+        if (signature->count == capacity) {
+            capacity = capacity == 0 ? 4 : capacity * 2;
+            struct Element *elements(pool.malloc<struct Element>(capacity * sizeof(struct Element)));
+            if (signature->count != 0)
+                memcpy(elements, signature->elements, signature->count * sizeof(struct Element));
+            signature->elements = elements;
+        }
 
         struct Element *element = &signature->elements[signature->count++];
 
@@ -248,199 +248,202 @@ void Parse(CYPool &pool, struct Signature *signature, const char *name, Callback
     _assert(temp[-1] == '\0');
 }
 
-const char *Unparse(CYPool &pool, const struct Signature *signature) {
-    const char *value = "";
-    size_t offset;
-
-    for (offset = 0; offset != signature->count; ++offset) {
-        const char *type = Unparse(pool, signature->elements[offset].type);
-        value = pool.strcat(value, type, NULL);
-    }
+static void Unparse(CYBuffer &buffer, const struct Signature *signature);
+static void Unparse(CYBuffer &buffer, const struct Type *type);
 
-    return value;
+const char *Unparse(CYPool &pool, const struct Signature *signature) {
+    CYBuffer value(pool);
+    Unparse(value, signature);
+    return value.Finish();
 }
 
 template <>
-const char *Primitive<bool>::Encode(CYPool &pool) const {
-    return "B";
+void Primitive<bool>::Encode(CYBuffer &buffer) const {
+    buffer << 'B';
 }
 
 template <>
-const char *Primitive<char>::Encode(CYPool &pool) const {
-    return "c";
+void Primitive<char>::Encode(CYBuffer &buffer) const {
+    buffer << 'c';
 }
 
 template <>
-const char *Primitive<double>::Encode(CYPool &pool) const {
-    return "d";
+void Primitive<double>::Encode(CYBuffer &buffer) const {
+    buffer << 'd';
 }
 
 template <>
-const char *Primitive<float>::Encode(CYPool &pool) const {
-    return "f";
+void Primitive<float>::Encode(CYBuffer &buffer) const {
+    buffer << 'f';
 }
 
 template <>
-const char *Primitive<long double>::Encode(CYPool &pool) const {
-    return "D";
+void Primitive<long double>::Encode(CYBuffer &buffer) const {
+    buffer << 'D';
 }
 
 template <>
-const char *Primitive<signed char>::Encode(CYPool &pool) const {
-    return "c";
+void Primitive<signed char>::Encode(CYBuffer &buffer) const {
+    buffer << 'c';
 }
 
 template <>
-const char *Primitive<signed int>::Encode(CYPool &pool) const {
-    return "i";
+void Primitive<signed int>::Encode(CYBuffer &buffer) const {
+    buffer << 'i';
 }
 
 #ifdef __SIZEOF_INT128__
 template <>
-const char *Primitive<signed __int128>::Encode(CYPool &pool) const {
-    return "t";
+void Primitive<signed __int128>::Encode(CYBuffer &buffer) const {
+    buffer << 't';
 }
 #endif
 
 template <>
-const char *Primitive<signed long int>::Encode(CYPool &pool) const {
-    return "l";
+void Primitive<signed long int>::Encode(CYBuffer &buffer) const {
+    buffer << 'l';
 }
 
 template <>
-const char *Primitive<signed long long int>::Encode(CYPool &pool) const {
-    return "q";
+void Primitive<signed long long int>::Encode(CYBuffer &buffer) const {
+    buffer << 'q';
 }
 
 template <>
-const char *Primitive<signed short int>::Encode(CYPool &pool) const {
-    return "s";
+void Primitive<signed short int>::Encode(CYBuffer &buffer) const {
+    buffer << 's';
 }
 
 template <>
-const char *Primitive<unsigned char>::Encode(CYPool &pool) const {
-    return "C";
+void Primitive<unsigned char>::Encode(CYBuffer &buffer) const {
+    buffer << 'C';
 }
 
 template <>
-const char *Primitive<unsigned int>::Encode(CYPool &pool) const {
-    return "I";
+void Primitive<unsigned int>::Encode(CYBuffer &buffer) const {
+    buffer << 'I';
 }
 
 #ifdef __SIZEOF_INT128__
 template <>
-const char *Primitive<unsigned __int128>::Encode(CYPool &pool) const {
-    return "T";
+void Primitive<unsigned __int128>::Encode(CYBuffer &buffer) const {
+    buffer << 'T';
 }
 #endif
 
 template <>
-const char *Primitive<unsigned long int>::Encode(CYPool &pool) const {
-    return "L";
+void Primitive<unsigned long int>::Encode(CYBuffer &buffer) const {
+    buffer << 'L';
 }
 
 template <>
-const char *Primitive<unsigned long long int>::Encode(CYPool &pool) const {
-    return "Q";
+void Primitive<unsigned long long int>::Encode(CYBuffer &buffer) const {
+    buffer << 'Q';
 }
 
 template <>
-const char *Primitive<unsigned short int>::Encode(CYPool &pool) const {
-    return "S";
+void Primitive<unsigned short int>::Encode(CYBuffer &buffer) const {
+    buffer << 'S';
 }
 
-const char *Void::Encode(CYPool &pool) const {
-    return "v";
+void Void::Encode(CYBuffer &buffer) const {
+    buffer << 'v';
 }
 
-const char *Unknown::Encode(CYPool &pool) const {
-    return "?";
+void Unknown::Encode(CYBuffer &buffer) const {
+    buffer << '?';
 }
 
-const char *String::Encode(CYPool &pool) const {
-    return "*";
+void String::Encode(CYBuffer &buffer) const {
+    buffer << '*';
 }
 
 #if CY_OBJECTIVEC
-const char *Meta::Encode(CYPool &pool) const {
-    return "#";
+void Meta::Encode(CYBuffer &buffer) const {
+    buffer << '#';
 }
 
-const char *Selector::Encode(CYPool &pool) const {
-    return ":";
+void Selector::Encode(CYBuffer &buffer) const {
+    buffer << ':';
 }
 #endif
 
-const char *Bits::Encode(CYPool &pool) const {
-    return pool.strcat("b", pool.itoa(size), NULL);
+void Bits::Encode(CYBuffer &buffer) const {
+    buffer << 'b' << size;
 }
 
-const char *Pointer::Encode(CYPool &pool) const {
-    return pool.strcat("^", type.Encode(pool), NULL);
+// the pointee and element types are encoded without their qualifiers
+void Pointer::Encode(CYBuffer &buffer) const {
+    buffer << '^';
+    type.Encode(buffer);
 }
 
-const char *Array::Encode(CYPool &pool) const {
-    return pool.strcat("[", pool.itoa(size), type.Encode(pool), "]", NULL);
+void Array::Encode(CYBuffer &buffer) const {
+    buffer << '[' << size;
+    type.Encode(buffer);
+    buffer << ']';
 }
 
 #if CY_OBJECTIVEC
-const char *Object::Encode(CYPool &pool) const {
-    return name == NULL ? "@" : pool.strcat("@\"", name, "\"", NULL);
+void Object::Encode(CYBuffer &buffer) const {
+    buffer << '@';
+    if (name != NULL)
+        buffer << '"' << name << '"';
 }
 #endif
 
-const char *Enum::Encode(CYPool &pool) const {
-    return type.Encode(pool);
+void Enum::Encode(CYBuffer &buffer) const {
+    type.Encode(buffer);
 }
 
-const char *Aggregate::Encode(CYPool &pool) const {
-    bool reference(signature.count == _not(size_t));
-    return pool.strcat(overlap ? "(" : "{",
-        name == NULL ? "?" : name,
-        reference ? "" : "=",
-        reference ? "" : Unparse(pool, &signature),
-    overlap ? ")" : "}", NULL);
+void Aggregate::Encode(CYBuffer &buffer) const {
+    buffer << (overlap ? '(' : '{') << (name == NULL ? "?" : name);
+    if (signature.count != _not(size_t)) {
+        buffer << '=';
+        Unparse(buffer, &signature);
+    }
+    buffer << (overlap ? ')' : '}');
 }
 
-const char *Function::Encode(CYPool &pool) const {
-    return "?";
+void Function::Encode(CYBuffer &buffer) const {
+    buffer << '?';
 }
 
 #if CY_OBJECTIVEC
-const char *Block::Encode(CYPool &pool) const {
-    return "@?";
+void Block::Encode(CYBuffer &buffer) const {
+    buffer << "@?";
 }
 #endif
 
-const char *Unparse(CYPool &pool, const struct Type *type) {
-    const char *base(type->Encode(pool));
-    if (type->flags == 0)
-        return base;
-
-    #define iovec_(base, size) \
-        (struct iovec) {const_cast<char *>(base), size}
-
-    size_t size(strlen(base));
-    char *buffer = static_cast<char*>(alloca(7 + size));
-    size_t offset(0);
-
-    if ((type->flags & JOC_TYPE_INOUT) != 0)
-        buffer[offset++] = 'N';
-    if ((type->flags & JOC_TYPE_IN) != 0)
-        buffer[offset++] = 'n';
-    if ((type->flags & JOC_TYPE_BYCOPY) != 0)
-        buffer[offset++] = 'O';
-    if ((type->flags & JOC_TYPE_OUT) != 0)
-        buffer[offset++] = 'o';
-    if ((type->flags & JOC_TYPE_BYREF) != 0)
-        buffer[offset++] = 'R';
-    if ((type->flags & JOC_TYPE_CONST) != 0)
-        buffer[offset++] = 'r';
-    if ((type->flags & JOC_TYPE_ONEWAY) != 0)
-        buffer[offset++] = 'V';
-
-    memcpy(buffer + offset, base, size);
-    return pool.strmemdup(buffer, offset + size);
+static void Unparse(CYBuffer &buffer, const struct Signature *signature) {
+    for (size_t offset(0); offset != signature->count; ++offset)
+        Unparse(buffer, signature->elements[offset].type);
+}
+
+static void Unparse(CYBuffer &buffer, const struct Type *type) {
+    if (type->flags != 0) {
+        if ((type->flags & JOC_TYPE_INOUT) != 0)
+            buffer << 'N';
+        if ((type->flags & JOC_TYPE_IN) != 0)
+            buffer << 'n';
+        if ((type->flags & JOC_TYPE_BYCOPY) != 0)
+            buffer << 'O';
+        if ((type->flags & JOC_TYPE_OUT) != 0)
+            buffer << 'o';
+        if ((type->flags & JOC_TYPE_BYREF) != 0)
+            buffer << 'R';
+        if ((type->flags & JOC_TYPE_CONST) != 0)
+            buffer << 'r';
+        if ((type->flags & JOC_TYPE_ONEWAY) != 0)
+            buffer << 'V';
+    }
+
+    type->Encode(buffer);
 }
 
+const char *Unparse(CYPool &pool, const struct Type *type) {
+    CYBuffer value(pool);
+    Unparse(value, type);
+    return value.Finish();
+}
 }
@@ -27,6 +27,7 @@
 
 #include "Standard.hpp"
 
+class CYBuffer;
 class CYPool;
 struct CYType;
 struct CYTypedParameter;
@@ -58,7 +59,7 @@ struct Type {
     virtual Type *Copy(CYPool &pool, const char *rename = NULL) const = 0;
     virtual const char *GetName() const;
 
-    virtual const char *Encode(CYPool &pool) const = 0;
+    virtual void Encode(CYBuffer &buffer) const = 0;
     virtual CYType *Decode(CYPool &pool) const = 0;
 };
 
@@ -70,7 +71,7 @@ struct Primitive :
         return Flag(new(pool) Primitive());
     }
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -98,7 +99,7 @@ struct Void :
 
     Void *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -107,7 +108,7 @@ struct Unknown :
 {
     Unknown *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -124,7 +125,7 @@ struct String :
 
     String *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -134,7 +135,7 @@ struct Meta :
 {
     Meta *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -143,7 +144,7 @@ struct Selector :
 {
     Selector *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 #endif
@@ -160,7 +161,7 @@ struct Bits :
 
     Bits *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -176,7 +177,7 @@ struct Pointer :
 
     Pointer *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -194,7 +195,7 @@ struct Array :
 
     Array *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -211,7 +212,7 @@ struct Object :
 
     Object *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 #endif
@@ -241,7 +242,7 @@ struct Enum :
     Enum *Copy(CYPool &pool, const char *rename = NULL) const override;
     const char *GetName() const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -261,7 +262,7 @@ struct Aggregate :
     Aggregate *Copy(CYPool &pool, const char *rename = NULL) const override;
     const char *GetName() const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
 };
 
@@ -286,7 +287,7 @@ struct Function :
 
     Function *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Modify(CYPool &pool, CYType *result, CYTypedParameter *parameters) const override;
 };
 
@@ -296,7 +297,7 @@ struct Block :
 {
     Block *Copy(CYPool &pool, const char *rename = NULL) const override;
 
-    const char *Encode(CYPool &pool) const override;
+    void Encode(CYBuffer &buffer) const override;
     CYType *Decode(CYPool &pool) const override;
     CYType *Modify(CYPool &pool, CYType *result, CYTypedParameter *parameters) const override;
 };